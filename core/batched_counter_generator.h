@@ -15,9 +15,18 @@
 #include <atomic>
 #include <mutex>
 #include <set>
+#include <vector>
 
 namespace ycsbc {
 
+///
+/// Hands out batches of consecutive keys to insert, and tracks which are
+/// completed: Last() is the first key of the first batch not completed.
+///
+/// A thread that stops inserting part way through a batch gives the rest
+/// of it back with ReturnUnused(); the next NextRange() hands that range
+/// out again, and the batch counts as completed once its last key is.
+///
 class BatchedCounterGenerator : public Generator<uint64_t> {
  public:
   BatchedCounterGenerator(uint64_t start, uint64_t batch_size) : start_(start), counter_(0), batch_size_(batch_size), mutex_(), num_completed_batches_(0), outstanding_() { }
@@ -33,6 +42,37 @@ class BatchedCounterGenerator : public Generator<uint64_t> {
   uint64_t Last() { return start_ + num_completed_batches_ * batch_size_; }
   uint64_t Set(uint64_t start) { assert(false); }
 
+  ///
+  /// Returns the first key of the next range to insert, and its length in
+  /// count: a range given back by ReturnUnused() if any, else a new batch.
+  ///
+  uint64_t NextRange(uint64_t &count) {
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      if (!unused_.empty()) {
+        uint64_t range_start = unused_.back();
+        unused_.pop_back();
+        count = BatchEnd(range_start) - range_start;
+        return range_start;
+      }
+    }
+    count = batch_size_;
+    return Next();
+  }
+
+  ///
+  /// Marks the batch of the range at range_start completed, once all but
+  /// its last unused keys are inserted; those are handed out again.
+  ///
+  void ReturnUnused(uint64_t range_start, uint64_t unused) {
+    if (unused == 0) {
+      MarkCompleted(range_start);
+      return;
+    }
+    std::lock_guard<std::mutex> lock(mutex_);
+    unused_.push_back(BatchEnd(range_start) - unused);
+  }
+
   void MarkCompleted(uint64_t batch_start) {
     std::lock_guard<std::mutex> lock(mutex_);
     uint64_t batch_num = (batch_start - start_) / batch_size_;
@@ -45,12 +85,17 @@ class BatchedCounterGenerator : public Generator<uint64_t> {
   }
 
  private:
+  uint64_t BatchEnd(uint64_t key) {
+    return start_ + ((key - start_) / batch_size_ + 1) * batch_size_;
+  }
+
   uint64_t start_;
   uint64_t counter_;
   uint64_t batch_size_;
   std::mutex mutex_;
   std::atomic<uint64_t> num_completed_batches_;
   std::set<uint64_t> outstanding_;
+  std::vector<uint64_t> unused_; ///< First keys of ranges given back
 };
 
 } // ycsbc
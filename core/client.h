@@ -12,6 +12,9 @@
 #include <string>
 #include "db.h"
 #include "core_workload.h"
+#include "measurements.h"
+#include "record_codec.h"
+#include "timer.h"
 #include "utils.h"
 
 namespace ycsbc {
@@ -24,14 +27,23 @@ class Client {
   }
   
   virtual bool DoInsert();
+  virtual bool DoBulkInsert();
   virtual bool DoTransaction();
+  virtual void Finish();
+
+  const Measurements &measurements() const { return measurements_; }
   
   virtual ~Client() { }
   
  protected:
   
   virtual int TransactionRead();
+  virtual void ReadValue(const std::string &key, std::string_view value);
+  virtual int TransactionBatchedRead();
+  virtual int FlushReads();
   virtual int TransactionReadModifyWrite();
+  virtual int TransactionMerge();
+  virtual int TransactionMultiRecord();
   virtual int TransactionScan();
   virtual int TransactionUpdate();
   virtual int TransactionInsert();
@@ -40,17 +52,40 @@ class Client {
   CoreWorkload &workload_;
   std::string key;
   std::vector<DB::KVPair> pairs;
+  std::vector<std::string> read_batch_;
+  std::vector<std::string> transaction_keys_;
+  std::string value_copy_;
+  Measurements measurements_;
+  utils::Timer<uint64_t, std::nano> op_timer_;
 };
 
 inline bool Client::DoInsert() {
   workload_.NextSequenceKey(key);
   workload_.UpdateValues(pairs);
-  return (db_.Insert(workload_.NextTable(), key, pairs) == DB::kOK);
+  op_timer_.Start();
+  int status = db_.Insert(workload_.NextTable(), key, pairs);
+  measurements_.Report(INSERT, op_timer_.End());
+  return (status == DB::kOK);
+}
+
+inline bool Client::DoBulkInsert() {
+  workload_.NextBulkLoadKey(key);
+  workload_.UpdateValues(pairs);
+  op_timer_.Start();
+  int status = db_.BulkInsert(workload_.NextTable(), key, pairs);
+  measurements_.Report(INSERT, op_timer_.End());
+  return (status == DB::kOK);
 }
 
 inline bool Client::DoTransaction() {
   int status = -1;
-  switch (workload_.NextOperation()) {
+  Operation op = workload_.NextOperation();
+  if (op == READ && workload_.read_batch_size() > 1) {
+    // Measured when the batch is issued
+    return (TransactionBatchedRead() == DB::kOK);
+  }
+  op_timer_.Start();
+  switch (op) {
     case READ:
       status = TransactionRead();
       break;
@@ -66,9 +101,16 @@ inline bool Client::DoTransaction() {
     case READMODIFYWRITE:
       status = TransactionReadModifyWrite();
       break;
+    case MERGE:
+      status = TransactionMerge();
+      break;
+    case TRANSACTION:
+      status = TransactionMultiRecord();
+      break;
     default:
       throw utils::Exception("Operation request is not recognized!");
   }
+  measurements_.Report(op, op_timer_.End());
   assert(status >= 0);
   return (status == DB::kOK);
 }
@@ -77,15 +119,106 @@ inline int Client::TransactionRead() {
   const std::string &table = workload_.NextTable();
   const std::string &key = workload_.NextTransactionKey();
   std::vector<DB::KVPair> result;
+  int status;
   if (!workload_.read_all_fields()) {
     std::vector<std::string> fields;
-    fields.push_back("field" + workload_.NextFieldName());
-    return db_.Read(table, key, &fields, result);
+    fields.push_back(workload_.NextFieldName());
+    status = db_.Read(table, key, &fields, result);
+  } else {
+    status = db_.Read(table, key, NULL, result);
+  }
+  std::string_view value;
+  if (workload_.read_value_mode() != READ_VALUE_NONE && db_.LastValue(value)) {
+    ReadValue(key, value);
+  }
+  return status;
+}
+
+//
+// Consumes a value read for key as the workload asks. Only engines
+// implementing DB::LastValue() or DB::LastMultiReadValue() hand one back:
+// the requested field, or the whole record encoded with RecordCodec when
+// all fields were read.
+//
+inline void Client::ReadValue(const std::string &key, std::string_view value) {
+  if (workload_.read_value_mode() == READ_VALUE_COPY) {
+    value_copy_.assign(value.data(), value.size());
+    return;
+  }
+  bool valid = true;
+  if (workload_.read_all_fields()) {
+    size_t n = RecordCodec::FieldCount(value);
+    valid = RecordCodec::Valid(value);
+    for (size_t i = 0; valid && i < n; i++) {
+      // Only fields the workload writes hold its values; others, like the
+      // counter of RocksDB's counter merge operator, are not checked
+      RecordCodec::FieldView f;
+      valid = RecordCodec::Field(value, i, f) &&
+          (!CoreWorkload::IsFieldName(f.first) || workload_.IsValidValue(f.second));
+    }
   } else {
-    return db_.Read(table, key, NULL, result);
+    valid = workload_.IsValidValue(value);
+  }
+  if (!valid) {
+    throw utils::Exception("Invalid value read for key " + key);
   }
 }
 
+//
+// Queues the read, and issues the queued reads as one MultiRead once
+// there are read_batch_size() of them.
+//
+inline int Client::TransactionBatchedRead() {
+  read_batch_.push_back(workload_.NextTransactionKey());
+  if (read_batch_.size() < workload_.read_batch_size()) {
+    return DB::kOK;
+  }
+  return FlushReads();
+}
+
+//
+// The batch latency is reported under MULTIREAD. How long each key of the
+// batch took on its own is not known, so each key is reported under
+// MULTIREAD_KEY with the batch latency divided by the batch size.
+//
+inline int Client::FlushReads() {
+  if (read_batch_.empty()) {
+    return DB::kOK;
+  }
+  const std::string &table = workload_.NextTable();
+  std::vector<std::vector<DB::KVPair>> result;
+  int status;
+  if (!workload_.read_all_fields()) {
+    std::vector<std::string> fields;
+    fields.push_back(workload_.NextFieldName());
+    op_timer_.Start();
+    status = db_.MultiRead(table, read_batch_, &fields, result);
+  } else {
+    op_timer_.Start();
+    status = db_.MultiRead(table, read_batch_, NULL, result);
+  }
+  uint64_t latency = op_timer_.End();
+  measurements_.Report(MULTIREAD, latency);
+  for (size_t i = 0; i < read_batch_.size(); i++) {
+    measurements_.Report(MULTIREAD_KEY, latency / read_batch_.size());
+  }
+  if (workload_.read_value_mode() != READ_VALUE_NONE) {
+    std::string_view value;
+    for (size_t i = 0; i < read_batch_.size(); i++) {
+      if (db_.LastMultiReadValue(i, value)) {
+        ReadValue(read_batch_[i], value);
+      }
+    }
+  }
+  read_batch_.clear();
+  return status;
+}
+
+inline void Client::Finish() {
+  FlushReads();
+  workload_.FinishInserts();
+}
+
 inline int Client::TransactionReadModifyWrite() {
   const std::string &table = workload_.NextTable();
   const std::string &key = workload_.NextTransactionKey();
@@ -93,7 +226,7 @@ inline int Client::TransactionReadModifyWrite() {
 
   if (!workload_.read_all_fields()) {
     std::vector<std::string> fields;
-    fields.push_back("field" + workload_.NextFieldName());
+    fields.push_back(workload_.NextFieldName());
     db_.Read(table, key, &fields, result);
   } else {
     db_.Read(table, key, NULL, result);
@@ -108,6 +241,61 @@ inline int Client::TransactionReadModifyWrite() {
   return db_.Update(table, key, values);
 }
 
+inline int Client::TransactionMerge() {
+  const std::string &table = workload_.NextTable();
+  const std::string &key = workload_.NextTransactionKey();
+  std::vector<DB::KVPair> values;
+  if (workload_.write_all_fields()) {
+    workload_.BuildValues(values);
+  } else {
+    workload_.BuildUpdate(values);
+  }
+  return db_.Merge(table, key, values);
+}
+
+//
+// Conflicting transactions are retried, with the same records, up to
+// transaction_retries() times. Any other error ends the transaction at
+// once. The latency includes all attempts.
+//
+inline int Client::TransactionMultiRecord() {
+  const std::string &table = workload_.NextTable();
+  transaction_keys_.clear();
+  for (size_t i = 0; i < workload_.transaction_keys(); i++) {
+    transaction_keys_.push_back(workload_.NextTransactionKey());
+  }
+  std::vector<DB::KVPair> values;
+  if (workload_.write_all_fields()) {
+    workload_.BuildValues(values);
+  } else {
+    workload_.BuildUpdate(values);
+  }
+  std::vector<std::string> fields;
+  if (!workload_.read_all_fields()) {
+    fields.push_back(workload_.NextFieldName());
+  }
+
+  int status;
+  uint64_t retries = 0;
+  for (;;) {
+    status = db_.ExecuteTransaction(table, transaction_keys_,
+                                    workload_.read_all_fields() ? NULL : &fields,
+                                    values);
+    if (status != DB::kErrorConflict || retries == workload_.transaction_retries()) {
+      break;
+    }
+    retries++;
+  }
+  if (status == DB::kOK) {
+    measurements_.ReportTransaction(retries, TRANSACTION_COMMITTED);
+  } else if (status == DB::kErrorConflict) {
+    measurements_.ReportTransaction(retries, TRANSACTION_GIVEN_UP);
+  } else {
+    measurements_.ReportTransaction(retries, TRANSACTION_FAILED);
+  }
+  return status;
+}
+
 inline int Client::TransactionScan() {
   const std::string &table = workload_.NextTable();
   const std::string &key = workload_.NextTransactionKey();
@@ -115,7 +303,7 @@ inline int Client::TransactionScan() {
   std::vector<std::vector<DB::KVPair>> result;
   if (!workload_.read_all_fields()) {
     std::vector<std::string> fields;
-    fields.push_back("field" + workload_.NextFieldName());
+    fields.push_back(workload_.NextFieldName());
     return db_.Scan(table, key, len, &fields, result);
   } else {
     return db_.Scan(table, key, len, NULL, result);
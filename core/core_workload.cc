@@ -14,6 +14,7 @@
 #include "core_workload.h"
 
 #include <string>
+#include <algorithm>
 
 using ycsbc::CoreWorkload;
 using std::string;
@@ -40,6 +41,12 @@ const string CoreWorkload::WRITE_ALL_FIELDS_DEFAULT = "false";
 const string CoreWorkload::READ_PROPORTION_PROPERTY = "readproportion";
 const string CoreWorkload::READ_PROPORTION_DEFAULT = "0.95";
 
+const string CoreWorkload::READ_BATCH_SIZE_PROPERTY = "readbatchsize";
+const string CoreWorkload::READ_BATCH_SIZE_DEFAULT = "1";
+
+const string CoreWorkload::READ_VALUE_PROPERTY = "readvalue";
+const string CoreWorkload::READ_VALUE_DEFAULT = "none";
+
 const string CoreWorkload::UPDATE_PROPORTION_PROPERTY = "updateproportion";
 const string CoreWorkload::UPDATE_PROPORTION_DEFAULT = "0.05";
 
@@ -53,6 +60,18 @@ const string CoreWorkload::READMODIFYWRITE_PROPORTION_PROPERTY =
     "readmodifywriteproportion";
 const string CoreWorkload::READMODIFYWRITE_PROPORTION_DEFAULT = "0.0";
 
+const string CoreWorkload::READMODIFYWRITE_MODE_PROPERTY = "rmwmode";
+const string CoreWorkload::READMODIFYWRITE_MODE_DEFAULT = "read";
+
+const string CoreWorkload::TRANSACTION_PROPORTION_PROPERTY = "transactionproportion";
+const string CoreWorkload::TRANSACTION_PROPORTION_DEFAULT = "0.0";
+
+const string CoreWorkload::TRANSACTION_KEYS_PROPERTY = "transactionkeys";
+const string CoreWorkload::TRANSACTION_KEYS_DEFAULT = "4";
+
+const string CoreWorkload::TRANSACTION_RETRIES_PROPERTY = "transactionretries";
+const string CoreWorkload::TRANSACTION_RETRIES_DEFAULT = "0";
+
 const string CoreWorkload::REQUEST_DISTRIBUTION_PROPERTY =
     "requestdistribution";
 const string CoreWorkload::REQUEST_DISTRIBUTION_DEFAULT = "uniform";
@@ -73,6 +92,21 @@ const string CoreWorkload::INSERT_ORDER_DEFAULT = "hashed";
 const string CoreWorkload::INSERT_START_PROPERTY = "insertstart";
 const string CoreWorkload::INSERT_START_DEFAULT = "0";
 
+const string CoreWorkload::LOAD_MODE_PROPERTY = "loadmode";
+const string CoreWorkload::LOAD_MODE_DEFAULT = "insert";
+
+const string CoreWorkload::LOAD_THREADS_PROPERTY = "loadthreads";
+const string CoreWorkload::LOAD_THREADS_DEFAULT = "0";
+
+const string CoreWorkload::LOAD_RATE_PROPERTY = "loadrate";
+const string CoreWorkload::LOAD_RATE_DEFAULT = "0";
+
+const string CoreWorkload::LOAD_COUNT_PROPERTY = "loadcount";
+const string CoreWorkload::LOAD_COUNT_DEFAULT = "0";
+
+const string CoreWorkload::LOAD_REPORT_INTERVAL_PROPERTY = "loadreportinterval";
+const string CoreWorkload::LOAD_REPORT_INTERVAL_DEFAULT = "1";
+
 const string CoreWorkload::RECORD_COUNT_PROPERTY = "recordcount";
 const string CoreWorkload::OPERATION_COUNT_PROPERTY = "operationcount";
 
@@ -97,12 +131,38 @@ void CoreWorkload::InitLoadWorkload(const utils::Properties &p, unsigned int nth
 
   insert_key_sequence_.Set(record_count_);
 
+  // Keys are taken from key_generator once this thread first inserts
   key_generator_ = key_generator;
-  key_batch_start_ = key_generator_->Next();
-  key_generator_batch_.Set(key_batch_start_);
-  batch_remaining_ = key_generator_->BatchSize();
 }
 
+uint64_t CoreWorkload::InitBulkLoadKeys(unsigned int nthreads, unsigned int this_thread) {
+  bulk_keys_.clear();
+  if (ordered_inserts_) {
+    bulk_next_ = (record_count_ * this_thread) / nthreads;
+    return (record_count_ * (this_thread + 1)) / nthreads - bulk_next_;
+  }
+
+  // Partition the hash space, so each thread loads a disjoint key range.
+  // Each key is hashed once, and this thread's keys are sorted by hash.
+  uint64_t low = (uint64_t)(((unsigned __int128)this_thread << 64) / nthreads);
+  uint64_t high = (uint64_t)(((unsigned __int128)(this_thread + 1) << 64) / nthreads);
+  bool last = this_thread + 1 == nthreads;
+  std::vector<std::pair<uint64_t, uint64_t>> hashed;
+  hashed.reserve(record_count_ / nthreads + 1);
+  for (uint64_t i = 0; i < record_count_; i++) {
+    uint64_t hash = utils::Hash(i);
+    if (low <= hash && (last || hash < high)) {
+      hashed.emplace_back(hash, i);
+    }
+  }
+  std::sort(hashed.begin(), hashed.end());
+  bulk_keys_.reserve(hashed.size());
+  for (auto &h : hashed) {
+    bulk_keys_.push_back(h.second);
+  }
+  bulk_next_ = 0;
+  return bulk_keys_.size();
+}
 
 void CoreWorkload::InitRunWorkload(const utils::Properties &p, unsigned int nthreads, unsigned int this_thread) {
   op_chooser_.Reset();
@@ -119,6 +179,10 @@ void CoreWorkload::InitRunWorkload(const utils::Properties &p, unsigned int nthr
                                                    SCAN_PROPORTION_DEFAULT));
   double readmodifywrite_proportion = std::stod(p.GetProperty(
       READMODIFYWRITE_PROPORTION_PROPERTY, READMODIFYWRITE_PROPORTION_DEFAULT));
+  std::string readmodifywrite_mode = p.GetProperty(READMODIFYWRITE_MODE_PROPERTY,
+                                                   READMODIFYWRITE_MODE_DEFAULT);
+  double transaction_proportion = std::stod(p.GetProperty(
+      TRANSACTION_PROPORTION_PROPERTY, TRANSACTION_PROPORTION_DEFAULT));
   
   std::string request_dist = p.GetProperty(REQUEST_DISTRIBUTION_PROPERTY,
                                            REQUEST_DISTRIBUTION_DEFAULT);
@@ -131,6 +195,22 @@ void CoreWorkload::InitRunWorkload(const utils::Properties &p, unsigned int nthr
                                                     READ_ALL_FIELDS_DEFAULT));
   write_all_fields_ = utils::StrToBool(p.GetProperty(WRITE_ALL_FIELDS_PROPERTY,
                                                      WRITE_ALL_FIELDS_DEFAULT));
+  read_batch_size_ = std::stoul(p.GetProperty(READ_BATCH_SIZE_PROPERTY,
+                                              READ_BATCH_SIZE_DEFAULT));
+  std::string read_value = p.GetProperty(READ_VALUE_PROPERTY, READ_VALUE_DEFAULT);
+  if (read_value == "none") {
+    read_value_mode_ = READ_VALUE_NONE;
+  } else if (read_value == "copy") {
+    read_value_mode_ = READ_VALUE_COPY;
+  } else if (read_value == "verify") {
+    read_value_mode_ = READ_VALUE_VERIFY;
+  } else {
+    throw utils::Exception("Unknown read value mode: " + read_value);
+  }
+  transaction_keys_ = std::stoul(p.GetProperty(TRANSACTION_KEYS_PROPERTY,
+                                               TRANSACTION_KEYS_DEFAULT));
+  transaction_retries_ = std::stoul(p.GetProperty(TRANSACTION_RETRIES_PROPERTY,
+                                                  TRANSACTION_RETRIES_DEFAULT));
   
   if (read_proportion > 0) {
     op_chooser_.AddValue(READ, read_proportion);
@@ -145,7 +225,18 @@ void CoreWorkload::InitRunWorkload(const utils::Properties &p, unsigned int nthr
     op_chooser_.AddValue(SCAN, scan_proportion);
   }
   if (readmodifywrite_proportion > 0) {
-    op_chooser_.AddValue(READMODIFYWRITE, readmodifywrite_proportion);
+    if (readmodifywrite_mode == "read") {
+      op_chooser_.AddValue(READMODIFYWRITE, readmodifywrite_proportion);
+    } else if (readmodifywrite_mode == "merge") {
+      op_chooser_.AddValue(MERGE, readmodifywrite_proportion);
+    } else {
+      throw utils::Exception("Unknown read-modify-write mode: " +
+                             readmodifywrite_mode);
+    }
+  }
+
+  if (transaction_proportion > 0) {
+    op_chooser_.AddValue(TRANSACTION, transaction_proportion);
   }
 
   op_chooser_.UpdateGenerator();
@@ -159,8 +250,15 @@ void CoreWorkload::InitRunWorkload(const utils::Properties &p, unsigned int nthr
     // that is larger than what exists at the beginning of the test.
     // If the generator picks a key that is not inserted yet, we just ignore it
     // and pick another key.
+    // Records inserted by concurrent loader threads grow the keyspace too;
+    // when their number is unbounded, allow the keyspace to double.
     int op_count = std::stoi(p.GetProperty(OPERATION_COUNT_PROPERTY));
     int new_keys = (int)(op_count * insert_proportion * 2); // a fudge factor
+    if (std::stoi(p.GetProperty(LOAD_THREADS_PROPERTY, LOAD_THREADS_DEFAULT)) > 0) {
+      uint64_t load_count = std::stoull(p.GetProperty(LOAD_COUNT_PROPERTY,
+                                                      LOAD_COUNT_DEFAULT));
+      new_keys += load_count ? load_count : record_count_;
+    }
     key_chooser_ = new ScrambledZipfianGenerator(generator_, record_count_ + new_keys);
     
   } else if (request_dist == "latest") {
@@ -235,3 +333,18 @@ void CoreWorkload::BuildUpdate(std::vector<ycsbc::DB::KVPair> &update) {
   update.push_back(pair);
 }
 
+//
+// Loaded values are a letter followed by underscores, and updated ones
+// repeat a single letter, so all but the first byte must be the same.
+//
+bool CoreWorkload::IsValidValue(std::string_view value) const {
+  if (value.size() < 2) {
+    return true;
+  }
+  char fill = value[1];
+  if (fill != '_' && (fill < 'a' || fill > 'z')) {
+    return false;
+  }
+  return value.find_first_not_of(fill, 1) == std::string_view::npos;
+}
+
@@ -21,12 +21,23 @@
 
 namespace ycsbc {
 
+enum ReadValueMode {
+  READ_VALUE_NONE,
+  READ_VALUE_COPY,
+  READ_VALUE_VERIFY
+};
+
 enum Operation {
   INSERT,
   READ,
   UPDATE,
   SCAN,
-  READMODIFYWRITE
+  READMODIFYWRITE,
+  MULTIREAD,
+  MULTIREAD_KEY,
+  MERGE,
+  TRANSACTION,
+  NUM_OPERATIONS
 };
 
 class CoreWorkload {
@@ -76,6 +87,21 @@ class CoreWorkload {
   static const std::string READ_PROPORTION_PROPERTY;
   static const std::string READ_PROPORTION_DEFAULT;
   
+  ///
+  /// The name of the property for the number of read transactions that are
+  /// grouped and issued together as a single batched lookup.
+  ///
+  static const std::string READ_BATCH_SIZE_PROPERTY;
+  static const std::string READ_BATCH_SIZE_DEFAULT;
+
+  ///
+  /// The name of the property for what clients do with the value returned
+  /// by each read. Options are "none", "copy" (copy it out of the DB) and
+  /// "verify" (check that it could have been written by this workload).
+  ///
+  static const std::string READ_VALUE_PROPERTY;
+  static const std::string READ_VALUE_DEFAULT;
+
   /// 
   /// The name of the property for the proportion of update transactions.
   ///
@@ -100,6 +126,34 @@ class CoreWorkload {
   ///
   static const std::string READMODIFYWRITE_PROPORTION_PROPERTY;
   static const std::string READMODIFYWRITE_PROPORTION_DEFAULT;
+
+  ///
+  /// The name of the property for how read-modify-write transactions are
+  /// issued. Options are "read" (a read followed by an update) and "merge"
+  /// (a single blind DB::Merge, reported as MERGE).
+  ///
+  static const std::string READMODIFYWRITE_MODE_PROPERTY;
+  static const std::string READMODIFYWRITE_MODE_DEFAULT;
+
+  ///
+  /// The name of the property for the proportion of multi-record
+  /// transactions, each of which reads and then writes several records.
+  ///
+  static const std::string TRANSACTION_PROPORTION_PROPERTY;
+  static const std::string TRANSACTION_PROPORTION_DEFAULT;
+
+  ///
+  /// The name of the property for the number of records in a transaction.
+  ///
+  static const std::string TRANSACTION_KEYS_PROPERTY;
+  static const std::string TRANSACTION_KEYS_DEFAULT;
+
+  ///
+  /// The name of the property for the number of times a transaction that
+  /// conflicted with another one is retried before it is given up.
+  ///
+  static const std::string TRANSACTION_RETRIES_PROPERTY;
+  static const std::string TRANSACTION_RETRIES_DEFAULT;
   
   /// 
   /// The name of the property for the the distribution of request keys.
@@ -137,6 +191,42 @@ class CoreWorkload {
 
   static const std::string INSERT_START_PROPERTY;
   static const std::string INSERT_START_DEFAULT;
+
+  ///
+  /// The name of the property for how the Load workload inserts records.
+  /// Options are "insert" (one record at a time, in insert order) and "bulk"
+  /// (each thread loads a disjoint key range in key order via BulkInsert).
+  ///
+  static const std::string LOAD_MODE_PROPERTY;
+  static const std::string LOAD_MODE_DEFAULT;
+
+  ///
+  /// The name of the property for the number of loader threads that keep
+  /// inserting new records while a Run workload executes (0 disables it).
+  ///
+  static const std::string LOAD_THREADS_PROPERTY;
+  static const std::string LOAD_THREADS_DEFAULT;
+
+  ///
+  /// The name of the property for the target aggregate insert rate of the
+  /// loader threads, in records per second (0 means unthrottled).
+  ///
+  static const std::string LOAD_RATE_PROPERTY;
+  static const std::string LOAD_RATE_DEFAULT;
+
+  ///
+  /// The name of the property for the maximum number of records the loader
+  /// threads insert (0 means keep inserting until the Run workload ends).
+  ///
+  static const std::string LOAD_COUNT_PROPERTY;
+  static const std::string LOAD_COUNT_DEFAULT;
+
+  ///
+  /// The name of the property for the interval, in seconds, at which the
+  /// number of records in the database is sampled during concurrent loads.
+  ///
+  static const std::string LOAD_REPORT_INTERVAL_PROPERTY;
+  static const std::string LOAD_REPORT_INTERVAL_DEFAULT;
   
   static const std::string RECORD_COUNT_PROPERTY;
   static const std::string OPERATION_COUNT_PROPERTY;
@@ -150,13 +240,23 @@ class CoreWorkload {
 
   void InitKeyBuffer(std::string &buffer);
 
+  ///
+  /// Selects this thread's share of the records for a bulk load.
+  /// Returns the number of records NextBulkLoadKey() will produce.
+  ///
+  uint64_t InitBulkLoadKeys(unsigned int nthreads, unsigned int this_thread);
+
   virtual void InitPairs(std::vector<ycsbc::DB::KVPair> &values);
   virtual void BuildValues(std::vector<ycsbc::DB::KVPair> &values);
   virtual void UpdateValues(std::vector<ycsbc::DB::KVPair> &values);
   virtual void BuildUpdate(std::vector<ycsbc::DB::KVPair> &update);
+  virtual bool IsValidValue(std::string_view value) const;
+  static bool IsFieldName(std::string_view name); /// Named like the fields this workload writes
   
   virtual std::string NextTable() { return table_name_; }
   virtual void NextSequenceKey(std::string &buffer); /// Used for loading data
+  virtual void FinishInserts(); /// Gives back the keys NextSequenceKey() did not use
+  virtual void NextBulkLoadKey(std::string &buffer); /// Used for bulk loading, in key order
   virtual std::string NextTransactionKey(); /// Used for transactions
   virtual Operation NextOperation() { return op_chooser_.Next(); }
   virtual std::string NextFieldName();
@@ -164,22 +264,32 @@ class CoreWorkload {
   
   bool read_all_fields() const { return read_all_fields_; }
   bool write_all_fields() const { return write_all_fields_; }
+  size_t read_batch_size() const { return read_batch_size_; }
+  ReadValueMode read_value_mode() const { return read_value_mode_; }
+  size_t transaction_keys() const { return transaction_keys_; }
+  size_t transaction_retries() const { return transaction_retries_; }
 
   CoreWorkload() :
       generator_(),
       field_count_(0),
       read_all_fields_(false),
       write_all_fields_(false),
+      read_batch_size_(1),
+      read_value_mode_(READ_VALUE_NONE),
+      transaction_keys_(0),
+      transaction_retries_(0),
       field_len_generator_(NULL),
       key_generator_(NULL),
       key_generator_batch_(0),
       batch_remaining_(0),
+      key_range_held_(false),
       op_chooser_(generator_),
       key_chooser_(NULL),
       field_chooser_(NULL),
       scan_len_chooser_(NULL),
       insert_key_sequence_(3),
       ordered_inserts_(true),
+      bulk_next_(0),
       record_count_(0),
       uniform_letter_dist_('a', 'z')
   {}
@@ -201,17 +311,24 @@ class CoreWorkload {
   int field_count_;
   bool read_all_fields_;
   bool write_all_fields_;
+  size_t read_batch_size_;
+  ReadValueMode read_value_mode_;
+  size_t transaction_keys_;
+  size_t transaction_retries_;
   Generator<uint64_t> *field_len_generator_;
   BatchedCounterGenerator *key_generator_;
   uint64_t key_batch_start_;
   CounterGenerator key_generator_batch_;
   uint64_t batch_remaining_;
+  bool key_range_held_;
   DiscreteGenerator<Operation> op_chooser_;
   Generator<uint64_t> *key_chooser_;
   Generator<uint64_t> *field_chooser_;
   Generator<uint64_t> *scan_len_chooser_;
   CounterGenerator insert_key_sequence_;
   bool ordered_inserts_;
+  uint64_t bulk_next_;
+  std::vector<uint64_t> bulk_keys_;
   size_t record_count_;
   int zero_padding_;
 
@@ -224,10 +341,12 @@ inline void CoreWorkload::InitKeyBuffer(std::string &buffer) {
 
 inline void CoreWorkload::NextSequenceKey(std::string &buffer) {
   if (batch_remaining_ == 0) {
-    key_generator_->MarkCompleted(key_batch_start_);
-    key_batch_start_ = key_generator_->Next();
+    if (key_range_held_) {
+      key_generator_->MarkCompleted(key_batch_start_);
+    }
+    key_batch_start_ = key_generator_->NextRange(batch_remaining_);
     key_generator_batch_.Set(key_batch_start_);
-    batch_remaining_ = key_generator_->BatchSize();
+    key_range_held_ = true;
   }
   uint64_t key_num = key_generator_batch_.Next();
   batch_remaining_--;
@@ -235,6 +354,26 @@ inline void CoreWorkload::NextSequenceKey(std::string &buffer) {
   UpdateKeyName(key_num, buffer);
 }
 
+//
+// Called when a thread stops inserting, so that its last batch of keys
+// counts as completed, and its unused keys go to another thread, rather
+// than hold Last() back for good.
+//
+inline void CoreWorkload::FinishInserts() {
+  if (!key_range_held_) {
+    return;
+  }
+  key_generator_->ReturnUnused(key_batch_start_, batch_remaining_);
+  key_range_held_ = false;
+  batch_remaining_ = 0;
+}
+
+inline void CoreWorkload::NextBulkLoadKey(std::string &buffer) {
+  // Hashed keys were sorted by InitBulkLoadKeys; ordered ones are a range
+  uint64_t key_num = bulk_keys_.empty() ? bulk_next_++ : bulk_keys_[bulk_next_++];
+  UpdateKeyName(key_num, buffer);
+}
+
 inline std::string CoreWorkload::NextTransactionKey() {
   uint64_t key_num;
   do {
@@ -269,6 +408,11 @@ inline void CoreWorkload::UpdateKeyName(uint64_t key_num, std::string &buffer) {
 inline std::string CoreWorkload::NextFieldName() {
   return std::string("field").append(std::to_string(field_chooser_->Next()));
 }
+
+inline bool CoreWorkload::IsFieldName(std::string_view name) {
+  return name.size() > 5 && name.substr(0, 5) == "field" &&
+      name.find_first_not_of("0123456789", 5) == std::string_view::npos;
+}
   
 } // ycsbc
 
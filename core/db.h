@@ -11,6 +11,7 @@
 
 #include <vector>
 #include <string>
+#include <string_view>
 
 namespace ycsbc {
 
@@ -44,6 +45,43 @@ class DB {
                    const std::vector<std::string> *fields,
                    std::vector<KVPair> &result) = 0;
   ///
+  /// Reads a batch of records from the database in one call.
+  /// Engines without a native batched lookup read the records one by one.
+  ///
+  /// @param table The name of the table.
+  /// @param keys The keys of the records to read.
+  /// @param fields The list of fields to read, or NULL for all of them.
+  /// @param result A vector of vector, where each vector contains field/value
+  ///        pairs for one record, in the order of keys
+  /// @return Zero on success, or a non-zero error code on error/record-miss.
+  ///
+  virtual int MultiRead(const std::string &table,
+                        const std::vector<std::string> &keys,
+                        const std::vector<std::string> *fields,
+                        std::vector<std::vector<KVPair>> &result) {
+    int status = kOK;
+    result.resize(keys.size());
+    for (size_t i = 0; i < keys.size(); i++) {
+      int s = Read(table, keys[i], fields, result[i]);
+      if (s != kOK) {
+        status = s;
+      }
+    }
+    return status;
+  }
+  ///
+  /// Returns a view of the value found by this thread's last Read(), valid
+  /// until the thread's next call into the DB. Engines that do not keep the
+  /// value around, or whose last Read() found nothing, return false.
+  ///
+  virtual bool LastValue(std::string_view &value) { return false; }
+  ///
+  /// Same, for the index-th key of this thread's last MultiRead().
+  ///
+  virtual bool LastMultiReadValue(size_t index, std::string_view &value) {
+    return false;
+  }
+  ///
   /// Performs a range scan for a set of records in the database.
   /// Field/value pairs from the result are stored in a vector.
   ///
@@ -71,6 +109,50 @@ class DB {
   virtual int Update(const std::string &table, const std::string &key,
                      std::vector<KVPair> &values) = 0;
   ///
+  /// Applies an update to a record without reading it first.
+  /// Engines without a merge primitive read the record and then update it.
+  ///
+  /// @param table The name of the table.
+  /// @param key The key of the record to merge into.
+  /// @param values A vector of field/value pairs to merge into the record.
+  /// @return Zero on success, a non-zero error code on error.
+  ///
+  virtual int Merge(const std::string &table, const std::string &key,
+                    std::vector<KVPair> &values) {
+    std::vector<KVPair> result;
+    Read(table, key, NULL, result);
+    return Update(table, key, values);
+  }
+  ///
+  /// Reads a set of records and then writes each of them, atomically.
+  /// Engines without transactions do the reads and writes one by one.
+  ///
+  /// @param table The name of the table.
+  /// @param keys The keys of the records to read and write.
+  /// @param fields The list of fields to read, or NULL for all of them.
+  /// @param values A vector of field/value pairs to update in every record.
+  /// @return Zero on success, kErrorConflict if the transaction conflicted
+  ///         with another one and was rolled back, or another non-zero error
+  ///         code on error.
+  ///
+  virtual int ExecuteTransaction(const std::string &table,
+                                 const std::vector<std::string> &keys,
+                                 const std::vector<std::string> *fields,
+                                 std::vector<KVPair> &values) {
+    std::vector<KVPair> result;
+    for (const std::string &key : keys) {
+      result.clear();
+      Read(table, key, fields, result);
+    }
+    for (const std::string &key : keys) {
+      int status = Update(table, key, values);
+      if (status != kOK) {
+        return status;
+      }
+    }
+    return kOK;
+  }
+  ///
   /// Inserts a record into the database.
   /// Field/value pairs in the specified vector are written into the record.
   ///
@@ -89,6 +171,31 @@ class DB {
   /// @return Zero on success, a non-zero error code on error.
   ///
   virtual int Delete(const std::string &table, const std::string &key) = 0;
+  ///
+  /// Inserts a record as part of a bulk load.
+  /// Each thread presents its keys in increasing order, and the key ranges of
+  /// different threads do not overlap. The records need not be visible until
+  /// FinishBulkLoad() returns.
+  ///
+  /// @param table The name of the table.
+  /// @param key The key of the record to insert.
+  /// @param values A vector of field/value pairs to insert in the record.
+  /// @return Zero on success, a non-zero error code on error.
+  ///
+  virtual int BulkInsert(const std::string &table, const std::string &key,
+                         std::vector<KVPair> &values) {
+    return Insert(table, key, values);
+  }
+  ///
+  /// Makes the records inserted by BulkInsert() visible.
+  /// Called once, from the main thread, after every loading thread's Close().
+  ///
+  virtual void FinishBulkLoad() { }
+  ///
+  /// Prints engine-specific statistics for the phase that just finished, and
+  /// resets them. Called from the main thread after every client's Close().
+  ///
+  virtual void PrintStats() { }
   
   virtual ~DB() { }
 };
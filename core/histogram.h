@@ -0,0 +1,117 @@
+//
+//  histogram.h
+//  YCSB-C
+//
+
+#ifndef YCSB_C_HISTOGRAM_H_
+#define YCSB_C_HISTOGRAM_H_
+
+#include <cstdint>
+#include <cstring>
+#include <algorithm>
+
+namespace utils {
+
+///
+/// Log-linear histogram of non-negative integer samples (e.g. latencies in
+/// nanoseconds). Each power of two is split into kSubBuckets linear buckets,
+/// so percentiles are accurate to within 1/kSubBuckets of the true value.
+///
+/// Not thread-safe: keep one per thread and Merge() them afterwards.
+///
+class Histogram {
+ public:
+  Histogram() { Clear(); }
+
+  void Clear();
+  void Add(uint64_t value);
+  void Merge(const Histogram &other);
+
+  uint64_t Count() const { return count_; }
+  uint64_t Min() const { return count_ ? min_ : 0; }
+  uint64_t Max() const { return max_; }
+  double Mean() const { return count_ ? (double)sum_ / count_ : 0.0; }
+
+  ///
+  /// Returns the smallest bucket bound below which at least p percent of the
+  /// samples fall, with p in [0, 100].
+  ///
+  uint64_t Percentile(double p) const;
+
+ private:
+  static const int kSubBucketBits = 4;
+  static const int kSubBuckets = 1 << kSubBucketBits;
+  static const int kNumBuckets = 64 * kSubBuckets;
+
+  static int BucketIndex(uint64_t value);
+  static uint64_t BucketLimit(int index);
+
+  uint64_t buckets_[kNumBuckets];
+  uint64_t count_;
+  uint64_t sum_;
+  uint64_t min_;
+  uint64_t max_;
+};
+
+inline void Histogram::Clear() {
+  memset(buckets_, 0, sizeof(buckets_));
+  count_ = 0;
+  sum_ = 0;
+  min_ = UINT64_MAX;
+  max_ = 0;
+}
+
+inline int Histogram::BucketIndex(uint64_t value) {
+  if (value < (uint64_t)kSubBuckets) {
+    return value;
+  }
+  int msb = 63 - __builtin_clzll(value);
+  int shift = msb - kSubBucketBits;
+  return (shift + 1) * kSubBuckets + ((value >> shift) & (kSubBuckets - 1));
+}
+
+inline uint64_t Histogram::BucketLimit(int index) {
+  if (index < kSubBuckets) {
+    return index;
+  }
+  int shift = index / kSubBuckets - 1;
+  uint64_t sub = index % kSubBuckets;
+  return ((kSubBuckets + sub) << shift) + ((uint64_t(1) << shift) - 1);
+}
+
+inline void Histogram::Add(uint64_t value) {
+  buckets_[BucketIndex(value)]++;
+  count_++;
+  sum_ += value;
+  min_ = std::min(min_, value);
+  max_ = std::max(max_, value);
+}
+
+inline void Histogram::Merge(const Histogram &other) {
+  for (int i = 0; i < kNumBuckets; i++) {
+    buckets_[i] += other.buckets_[i];
+  }
+  count_ += other.count_;
+  sum_ += other.sum_;
+  min_ = std::min(min_, other.min_);
+  max_ = std::max(max_, other.max_);
+}
+
+inline uint64_t Histogram::Percentile(double p) const {
+  if (count_ == 0) {
+    return 0;
+  }
+  uint64_t threshold = (uint64_t)(count_ * (p / 100.0));
+  uint64_t seen = 0;
+  for (int i = 0; i < kNumBuckets; i++) {
+    seen += buckets_[i];
+    if (seen > threshold || seen == count_) {
+      return std::min(BucketLimit(i), max_);
+    }
+  }
+  return max_;
+}
+
+} // utils
+
+#endif // YCSB_C_HISTOGRAM_H_
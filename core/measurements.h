@@ -0,0 +1,151 @@
+//
+//  measurements.h
+//  YCSB-C
+//
+
+#ifndef YCSB_C_MEASUREMENTS_H_
+#define YCSB_C_MEASUREMENTS_H_
+
+#include <iostream>
+#include <iomanip>
+#include <string>
+#include "core_workload.h"
+#include "histogram.h"
+
+namespace ycsbc {
+
+inline const char *OperationName(Operation op) {
+  switch (op) {
+    case INSERT: return "INSERT";
+    case READ: return "READ";
+    case UPDATE: return "UPDATE";
+    case SCAN: return "SCAN";
+    case READMODIFYWRITE: return "READMODIFYWRITE";
+    case MULTIREAD: return "MULTIREAD";
+    case MULTIREAD_KEY: return "MULTIREAD_KEY";
+    case MERGE: return "MERGE";
+    case TRANSACTION: return "TRANSACTION";
+    default: return "UNKNOWN";
+  }
+}
+
+///
+/// How a transaction ended: committed, given up after its last attempt
+/// conflicted, or failed with another error.
+///
+enum TransactionOutcome {
+  TRANSACTION_COMMITTED,
+  TRANSACTION_GIVEN_UP,
+  TRANSACTION_FAILED
+};
+
+///
+/// Per-operation latency histograms for one client thread.
+/// Latencies are recorded in nanoseconds and reported in microseconds.
+///
+class Measurements {
+ public:
+  Measurements() : transaction_commits_(0), transaction_give_ups_(0),
+                   transaction_failures_(0), transaction_retries_(0) { }
+
+  void Report(Operation op, uint64_t latency_ns) {
+    histograms_[op].Add(latency_ns);
+  }
+
+  ///
+  /// Records the outcome of one transaction, and the number of times it
+  /// conflicted and was retried before that.
+  ///
+  void ReportTransaction(uint64_t retries, TransactionOutcome outcome) {
+    transaction_retries_ += retries;
+    switch (outcome) {
+      case TRANSACTION_COMMITTED: transaction_commits_++; break;
+      case TRANSACTION_GIVEN_UP: transaction_give_ups_++; break;
+      case TRANSACTION_FAILED: transaction_failures_++; break;
+    }
+  }
+
+  void Merge(const Measurements &other) {
+    for (int i = 0; i < NUM_OPERATIONS; i++) {
+      histograms_[i].Merge(other.histograms_[i]);
+    }
+    transaction_commits_ += other.transaction_commits_;
+    transaction_give_ups_ += other.transaction_give_ups_;
+    transaction_failures_ += other.transaction_failures_;
+    transaction_retries_ += other.transaction_retries_;
+  }
+
+  void Clear() {
+    for (int i = 0; i < NUM_OPERATIONS; i++) {
+      histograms_[i].Clear();
+    }
+    transaction_commits_ = 0;
+    transaction_give_ups_ = 0;
+    transaction_failures_ = 0;
+    transaction_retries_ = 0;
+  }
+
+  ///
+  /// Prints one comment line per operation type that was executed,
+  /// so the output stays compatible with parse_result.py.
+  ///
+  void Print(std::ostream &out, const std::string &title) const;
+
+  static void PrintHeader(std::ostream &out, const std::string &title);
+  static void PrintHistogram(std::ostream &out, const std::string &name,
+                             const utils::Histogram &h);
+
+ private:
+  utils::Histogram histograms_[NUM_OPERATIONS];
+  uint64_t transaction_commits_;
+  uint64_t transaction_give_ups_;
+  uint64_t transaction_failures_;
+  uint64_t transaction_retries_;
+};
+
+inline void Measurements::PrintHeader(std::ostream &out, const std::string &title) {
+  out << "# " << title << " latency (us)" << std::endl;
+  out << "#\top\tcount\tavg\tp50\tp99\tp99.9\tmax" << std::endl;
+}
+
+inline void Measurements::PrintHistogram(std::ostream &out,
+                                         const std::string &name,
+                                         const utils::Histogram &h) {
+  std::ios_base::fmtflags flags = out.flags();
+  std::streamsize precision = out.precision();
+  out << "#\t" << name << '\t' << h.Count() << std::fixed << std::setprecision(2)
+      << '\t' << h.Mean() / 1000
+      << '\t' << h.Percentile(50) / 1000.0
+      << '\t' << h.Percentile(99) / 1000.0
+      << '\t' << h.Percentile(99.9) / 1000.0
+      << '\t' << h.Max() / 1000.0 << std::endl;
+  out.flags(flags);
+  out.precision(precision);
+}
+
+inline void Measurements::Print(std::ostream &out, const std::string &title) const {
+  PrintHeader(out, title);
+  for (int i = 0; i < NUM_OPERATIONS; i++) {
+    if (histograms_[i].Count()) {
+      PrintHistogram(out, OperationName((Operation)i), histograms_[i]);
+    }
+  }
+  uint64_t transactions = transaction_commits_ + transaction_give_ups_
+      + transaction_failures_;
+  if (transactions) {
+    // Each transaction made one attempt plus one per retry. Retried
+    // attempts and those given up conflicted; failed ones did not.
+    uint64_t attempts = transactions + transaction_retries_;
+    uint64_t conflicts = transaction_retries_ + transaction_give_ups_;
+    out << "# Transactions committed:\t" << transaction_commits_ << std::endl;
+    out << "# Transactions given up:\t" << transaction_give_ups_ << std::endl;
+    out << "# Transactions failed:\t" << transaction_failures_ << std::endl;
+    out << "# Transaction retries:\t" << transaction_retries_ << std::endl;
+    out << "# Transaction abort rate:\t"
+        << (double)conflicts / attempts << std::endl;
+  }
+}
+
+} // ycsbc
+
+#endif // YCSB_C_MEASUREMENTS_H_
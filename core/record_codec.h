@@ -0,0 +1,300 @@
+//
+//  record_codec.h
+//  YCSB-C
+//
+
+#ifndef YCSB_C_RECORD_CODEC_H_
+#define YCSB_C_RECORD_CODEC_H_
+
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <string_view>
+#include <vector>
+#include "db.h"
+
+namespace ycsbc {
+
+///
+/// Binary encoding of the field/value pairs of a record, for DBs that store
+/// each record as a single byte string.
+///
+/// A record is its number of fields n, a table of n + 1 offsets giving where
+/// each field starts and where the last one ends, then the fields, each a
+/// name length, the name and the value:
+///
+///   uint32 n | uint32 offset[n + 1] | uint16 len, name, value | ...
+///
+/// so a field is found in constant time from its index, and can be
+/// overwritten in place by a value of the same length.
+///
+/// Stored records may come from elsewhere, so decoding never trusts them:
+/// a record too short for its offset table has no fields, and a field whose
+/// offsets fall outside the record is not found.
+///
+class RecordCodec {
+ public:
+  typedef std::pair<std::string_view, std::string_view> FieldView;
+
+  static void Encode(const std::vector<DB::KVPair> &values, std::string &record);
+
+  ///
+  /// Appends the requested fields of record, or all of them if fields is
+  /// NULL, to result. Fields the record does not have are skipped.
+  ///
+  static void Decode(std::string_view record,
+                     const std::vector<std::string> *fields,
+                     std::vector<DB::KVPair> &result);
+
+  static size_t FieldCount(std::string_view record);
+
+  ///
+  /// Whether record is well formed: its offset table fits, and each field
+  /// lies within the record, one after the other up to its end.
+  ///
+  static bool Valid(std::string_view record);
+
+  ///
+  /// Sets field to the index-th field of record. Returns false if there is
+  /// no such field, or it is malformed.
+  ///
+  static bool Field(std::string_view record, size_t index, FieldView &field);
+
+  ///
+  /// Finds the field called name. Fields called "field<i>", as generated by
+  /// CoreWorkload, are looked up directly at index i.
+  ///
+  static bool Find(std::string_view record, std::string_view name, size_t &index);
+
+  ///
+  /// Sets the given fields of record, adding those it does not have.
+  /// Values of unchanged length are overwritten in place. A record that
+  /// must be re-encoded but cannot be decoded is replaced by one of the
+  /// given fields alone.
+  ///
+  static void Patch(std::string &record, const std::vector<DB::KVPair> &values);
+
+  ///
+  /// Same, with the fields taken from another encoded record.
+  ///
+  static void Patch(std::string &record, std::string_view patch);
+
+ private:
+  static const size_t kCountSize = sizeof(uint32_t);
+  static const size_t kOffsetSize = sizeof(uint32_t);
+  static const size_t kNameLenSize = sizeof(uint16_t);
+
+  static uint32_t Offset(std::string_view record, size_t index) {
+    uint32_t offset;
+    memcpy(&offset, record.data() + kCountSize + index * kOffsetSize, sizeof(offset));
+    return offset;
+  }
+
+  static void PatchFields(std::string &record, const std::vector<FieldView> &patch);
+  static void EncodeFields(const std::vector<FieldView> &fields, std::string &record);
+};
+
+inline void RecordCodec::EncodeFields(const std::vector<FieldView> &fields,
+                                      std::string &record) {
+  uint32_t n = fields.size();
+  size_t size = kCountSize + (n + 1) * kOffsetSize;
+  for (const FieldView &f : fields) {
+    size += kNameLenSize + f.first.size() + f.second.size();
+  }
+  record.resize(size);
+  char *p = &record[0];
+  memcpy(p, &n, sizeof(n));
+  uint32_t offset = kCountSize + (n + 1) * kOffsetSize;
+  for (uint32_t i = 0; i < n; i++) {
+    memcpy(p + kCountSize + i * kOffsetSize, &offset, sizeof(offset));
+    uint16_t name_len = fields[i].first.size();
+    memcpy(p + offset, &name_len, sizeof(name_len));
+    memcpy(p + offset + kNameLenSize, fields[i].first.data(), name_len);
+    memcpy(p + offset + kNameLenSize + name_len, fields[i].second.data(),
+           fields[i].second.size());
+    offset += kNameLenSize + name_len + fields[i].second.size();
+  }
+  memcpy(p + kCountSize + n * kOffsetSize, &offset, sizeof(offset));
+}
+
+inline void RecordCodec::Encode(const std::vector<DB::KVPair> &values,
+                                std::string &record) {
+  static thread_local std::vector<FieldView> fields;
+  fields.clear();
+  for (const DB::KVPair &pair : values) {
+    fields.emplace_back(pair.first, pair.second);
+  }
+  EncodeFields(fields, record);
+}
+
+inline size_t RecordCodec::FieldCount(std::string_view record) {
+  if (record.size() < kCountSize) {
+    return 0;
+  }
+  uint32_t n;
+  memcpy(&n, record.data(), sizeof(n));
+  if ((record.size() - kCountSize) / kOffsetSize < (size_t)n + 1) {
+    return 0; // the offset table does not fit
+  }
+  return n;
+}
+
+inline bool RecordCodec::Valid(std::string_view record) {
+  if (record.size() < kCountSize) {
+    return false;
+  }
+  uint32_t n;
+  memcpy(&n, record.data(), sizeof(n));
+  if ((record.size() - kCountSize) / kOffsetSize < (size_t)n + 1) {
+    return false;
+  }
+  uint32_t offset = kCountSize + (n + 1) * kOffsetSize;
+  for (size_t i = 0; i < n; i++) {
+    FieldView f;
+    if (Offset(record, i) != offset || !Field(record, i, f)) {
+      return false;
+    }
+    offset = Offset(record, i + 1);
+  }
+  return Offset(record, n) == offset && offset == record.size();
+}
+
+inline bool RecordCodec::Field(std::string_view record, size_t index,
+                               FieldView &field) {
+  if (index >= FieldCount(record)) {
+    return false;
+  }
+  uint32_t start = Offset(record, index);
+  uint32_t end = Offset(record, index + 1);
+  if (end > record.size() || start > end || end - start < kNameLenSize) {
+    return false;
+  }
+  uint16_t name_len;
+  memcpy(&name_len, record.data() + start, sizeof(name_len));
+  if (name_len > end - start - kNameLenSize) {
+    return false;
+  }
+  uint32_t value_start = start + kNameLenSize + name_len;
+  field = FieldView(record.substr(start + kNameLenSize, name_len),
+                    record.substr(value_start, end - value_start));
+  return true;
+}
+
+inline bool RecordCodec::Find(std::string_view record, std::string_view name,
+                              size_t &index) {
+  size_t n = FieldCount(record);
+  size_t digits = name.find_first_of("0123456789");
+  if (name.substr(0, digits) == "field" && digits != std::string_view::npos) {
+    size_t i = 0;
+    for (char c : name.substr(digits)) {
+      i = i * 10 + (c - '0');
+    }
+    FieldView f;
+    if (i < n && Field(record, i, f) && f.first == name) {
+      index = i;
+      return true;
+    }
+  }
+  for (size_t i = 0; i < n; i++) {
+    FieldView f;
+    if (Field(record, i, f) && f.first == name) {
+      index = i;
+      return true;
+    }
+  }
+  return false;
+}
+
+inline void RecordCodec::Decode(std::string_view record,
+                                const std::vector<std::string> *fields,
+                                std::vector<DB::KVPair> &result) {
+  if (!fields) {
+    size_t n = FieldCount(record);
+    FieldView f;
+    for (size_t i = 0; i < n && Field(record, i, f); i++) {
+      result.emplace_back(std::string(f.first), std::string(f.second));
+    }
+    return;
+  }
+  for (const std::string &name : *fields) {
+    size_t i;
+    FieldView f;
+    if (Find(record, name, i) && Field(record, i, f)) {
+      result.emplace_back(name, std::string(f.second));
+    }
+  }
+}
+
+inline void RecordCodec::PatchFields(std::string &record,
+                                     const std::vector<FieldView> &patch) {
+  bool in_place = true;
+  for (const FieldView &f : patch) {
+    size_t i;
+    FieldView old;
+    if (!Find(record, f.first, i) || !Field(record, i, old) ||
+        old.second.size() != f.second.size()) {
+      in_place = false;
+      break;
+    }
+  }
+  if (in_place) {
+    for (const FieldView &f : patch) {
+      size_t i;
+      FieldView old;
+      Find(record, f.first, i);
+      Field(record, i, old);
+      memcpy(&record[old.second.data() - record.data()], f.second.data(), f.second.size());
+    }
+    return;
+  }
+
+  // Some value changes length, or some field is new: re-encode the record
+  static thread_local std::vector<FieldView> fields;
+  static thread_local std::string rebuilt;
+  fields.clear();
+  size_t n = FieldCount(record);
+  bool malformed = false;
+  for (size_t i = 0; i < n && !malformed; i++) {
+    FieldView f;
+    malformed = !Field(record, i, f);
+    fields.push_back(f);
+  }
+  if (malformed) {
+    fields.clear(); // keep none of it
+  }
+  for (const FieldView &f : patch) {
+    size_t i;
+    if (!malformed && Find(record, f.first, i)) {
+      fields[i].second = f.second;
+    } else {
+      fields.push_back(f);
+    }
+  }
+  EncodeFields(fields, rebuilt);
+  record.swap(rebuilt);
+}
+
+inline void RecordCodec::Patch(std::string &record,
+                               const std::vector<DB::KVPair> &values) {
+  static thread_local std::vector<FieldView> patch;
+  patch.clear();
+  for (const DB::KVPair &pair : values) {
+    patch.emplace_back(pair.first, pair.second);
+  }
+  PatchFields(record, patch);
+}
+
+inline void RecordCodec::Patch(std::string &record, std::string_view patch_record) {
+  static thread_local std::vector<FieldView> patch;
+  patch.clear();
+  size_t n = FieldCount(patch_record);
+  FieldView f;
+  for (size_t i = 0; i < n && Field(patch_record, i, f); i++) {
+    patch.push_back(f);
+  }
+  PatchFields(record, patch);
+}
+
+} // ycsbc
+
+#endif // YCSB_C_RECORD_CODEC_H_
@@ -13,7 +13,7 @@
 
 namespace utils {
 
-template <typename T>
+template <typename T, typename Period = std::ratio<1>>
 class Timer {
  public:
   void Start() {
@@ -29,7 +29,7 @@ class Timer {
 
  private:
   typedef std::chrono::high_resolution_clock Clock;
-  typedef std::chrono::duration<T> Duration;
+  typedef std::chrono::duration<T, Period> Duration;
 
   Clock::time_point time_;
 };
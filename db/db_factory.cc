@@ -8,39 +8,93 @@
 
 #include "db/db_factory.h"
 
+#include <iostream>
 #include <string>
 #include "db/basic_db.h"
+#include "db/flat_db.h"
 #include "db/lock_stl_db.h"
+#include "db/memcached_db.h"
 #include "db/redis_db.h"
+#include "db/redis_async_db.h"
+#include "db/skiplist_db.h"
 #include "db/tbb_rand_db.h"
 #include "db/tbb_scan_db.h"
 #include "db/splinter_db.h"
+#include "db/swiss_db.h"
 #include "db/rocks_db.h"
+#include "lib/flat_record.h"
+#include "lib/mem_alloc.h"
+#include "lib/slab_alloc.h"
 
 using namespace std;
 using ycsbc::DB;
 using ycsbc::DBFactory;
 
+//
+// The in-memory engines keep each record as a table of fields, or as one
+// flat record when hashtable.layout is "flat".
+//
+template <template <class> class HashtableDBType, class MA>
+static DB *NewHashtableDB(utils::Properties &props) {
+  if (props["hashtable.layout"] == "fields") {
+    return new HashtableDBType<MA>;
+  } else if (props["hashtable.layout"] == "flat") {
+    return new ycsbc::FlatDB<MA>(
+        HashtableDBType<MA>::template NewKeyHashtable<vmp::FlatRecord *>());
+  } else {
+    cout << "Unknown hashtable.layout " << props["hashtable.layout"] << endl;
+    assert(0);
+    return NULL;
+  }
+}
+
+//
+// They allocate their keys and values with malloc(), or from vmp::SlabAlloc
+// when hashtable.allocator is "slab".
+//
+template <template <class> class HashtableDBType>
+static DB *NewHashtableDB(utils::Properties &props) {
+  if (props["hashtable.allocator"] == "malloc") {
+    return NewHashtableDB<HashtableDBType, MemAlloc>(props);
+  } else if (props["hashtable.allocator"] == "slab") {
+    vmp::SlabAlloc::set_huge_pages(props.GetIntProperty("hashtable.huge_pages"));
+    return NewHashtableDB<HashtableDBType, vmp::SlabAlloc>(props);
+  } else {
+    cout << "Unknown hashtable.allocator " << props["hashtable.allocator"]
+         << endl;
+    assert(0);
+    return NULL;
+  }
+}
+
 DB* DBFactory::CreateDB(utils::Properties &props, bool preloaded) {
   if (props["dbname"] == "basic") {
     return new BasicDB(props);
   } else if (props["dbname"] == "lock_stl") {
     assert(!preloaded);
-    return new LockStlDB;
+    return NewHashtableDB<LockStlDB>(props);
+  } else if (props["dbname"] == "memcached") {
+    return new MemcachedDB(props);
   } else if (props["dbname"] == "redis") {
-    int port = stoi(props["port"]);
-    int slaves = stoi(props["slaves"]);
-    return new RedisDB(props["host"].c_str(), port, slaves);
+    return new RedisDB(props);
+  } else if (props["dbname"] == "redis_async") {
+    return new RedisAsyncDB(props);
   } else if (props["dbname"] == "rocksdb") {
     return new RocksDB(props, preloaded);
+  } else if (props["dbname"] == "skiplist") {
+    assert(!preloaded);
+    return NewHashtableDB<SkipListDB>(props);
   } else if (props["dbname"] == "splinterdb") {
     return new SplinterDB(props, preloaded);
+  } else if (props["dbname"] == "swiss") {
+    assert(!preloaded);
+    return NewHashtableDB<SwissDB>(props);
   } else if (props["dbname"] == "tbb_rand") {
     assert(!preloaded);
-    return new TbbRandDB;
+    return NewHashtableDB<TbbRandDB>(props);
   } else if (props["dbname"] == "tbb_scan") {
     assert(!preloaded);
-    return new TbbScanDB;
+    return NewHashtableDB<TbbScanDB>(props);
   } else return NULL;
 }
 
@@ -0,0 +1,48 @@
+//
+//  flat_db.h
+//  YCSB-C
+//
+
+#ifndef YCSB_C_FLAT_DB_H_
+#define YCSB_C_FLAT_DB_H_
+
+#include "db/flat_hashtable_db.h"
+
+#include <vector>
+#include "lib/epoch.h"
+#include "lib/flat_record.h"
+#include "lib/mem_alloc.h"
+
+namespace ycsbc {
+
+///
+/// Flat records, allocated with MA, in the key table of any of the
+/// in-memory engines (see their NewKeyHashtable()).
+///
+template <class MA = MemAlloc>
+class FlatDB : public FlatHashtableDB {
+ public:
+  FlatDB(KeyHashtable *table) : FlatHashtableDB(table) { }
+
+  ~FlatDB() {
+    vmp::Epoch::Drain();
+    std::vector<KeyHashtable::KVPair> key_pairs = key_table_->Entries();
+    for (auto &key_pair : key_pairs) {
+      FreeRecord(key_pair.second);
+    }
+    delete key_table_;
+  }
+
+ protected:
+  void *AllocateRecord(std::size_t size) {
+    return MA::Malloc(size);
+  }
+
+  void FreeRecord(vmp::FlatRecord *record) {
+    MA::Free(record, record->size());
+  }
+};
+
+} // ycsbc
+
+#endif // YCSB_C_FLAT_DB_H_
@@ -0,0 +1,215 @@
+//
+//  flat_hashtable_db.cc
+//  YCSB-C
+//
+
+#include "db/flat_hashtable_db.h"
+
+#include <cassert>
+#include <chrono>
+#include <iostream>
+#include <string>
+#include <vector>
+#include "core/measurements.h"
+#include "db/hashtable_db.h"
+#include "lib/epoch.h"
+
+using std::cerr;
+using std::endl;
+using std::string;
+using std::vector;
+using vmp::FlatRecord;
+
+namespace ycsbc {
+
+struct FlatThreadState {
+  string key_index; // table + key, reused across operations
+
+  utils::Histogram copy_latency;
+  uint64_t read_retries = 0;
+  uint64_t in_place_updates = 0;
+  uint64_t copied_updates = 0;
+};
+
+static thread_local FlatThreadState *thread_state = NULL;
+
+static inline uint64_t NowNanos() {
+  return std::chrono::duration_cast<std::chrono::nanoseconds>(
+      std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+void FlatHashtableDB::Init() {
+  thread_state = new FlatThreadState();
+}
+
+void FlatHashtableDB::Close() {
+  {
+    std::lock_guard<std::mutex> lock(stats_mutex_);
+    copy_latency_.Merge(thread_state->copy_latency);
+    read_retries_ += thread_state->read_retries;
+    in_place_updates_ += thread_state->in_place_updates;
+    copied_updates_ += thread_state->copied_updates;
+  }
+  delete thread_state;
+  thread_state = NULL;
+}
+
+const char *FlatHashtableDB::KeyIndex(const string &table, const string &key) {
+  thread_state->key_index.assign(table).append(key);
+  return thread_state->key_index.c_str();
+}
+
+FlatRecord *FlatHashtableDB::NewRecord(const vector<KVPair> &fields) {
+  size_t size = FlatRecord::SizeFor(fields);
+  record_bytes_.fetch_add(size, std::memory_order_relaxed);
+  return FlatRecord::Build(AllocateRecord(size), fields);
+}
+
+//
+// Frees a record that no other thread has seen.
+//
+void FlatHashtableDB::DiscardRecord(FlatRecord *record) {
+  record_bytes_.fetch_sub(record->size(), std::memory_order_relaxed);
+  FreeRecord(record);
+}
+
+void FlatHashtableDB::RetireRecord(FlatRecord *record) {
+  record_bytes_.fetch_sub(record->size(), std::memory_order_relaxed);
+  vmp::Epoch::Retire(record, &FreeRetiredRecord, this);
+}
+
+void FlatHashtableDB::FreeRetiredRecord(void *record, void *db) {
+  ((FlatHashtableDB *)db)->FreeRecord((FlatRecord *)record);
+}
+
+int FlatHashtableDB::Read(const string &table, const string &key,
+    const vector<string> *fields, vector<KVPair> &result) {
+  vmp::EpochGuard guard;
+  FlatRecord *record = key_table_->Get(KeyIndex(table, key));
+  if (!record) return DB::kErrorNoData;
+
+  result.clear();
+  uint64_t start = NowNanos();
+  thread_state->read_retries += record->Read(fields, result);
+  thread_state->copy_latency.Add(NowNanos() - start);
+  return DB::kOK;
+}
+
+int FlatHashtableDB::Scan(const string &table, const string &key, int len,
+    const vector<string> *fields, vector<vector<KVPair>> &result) {
+  vmp::EpochGuard guard;
+  vector<KeyHashtable::KVPair> key_pairs =
+      key_table_->Entries(KeyIndex(table, key), len);
+
+  result.resize(key_pairs.size());
+  for (size_t i = 0; i < key_pairs.size(); ++i) {
+    result[i].clear();
+    thread_state->read_retries += key_pairs[i].second->Read(fields, result[i]);
+  }
+  return DB::kOK;
+}
+
+//
+// Values that fit are written into the record in place. Otherwise a bigger
+// copy replaces the record, which is marked obsolete so that writers waiting
+// on its lock look the record up again. Records are only replaced or removed
+// under their lock, so a locked record that is not obsolete is the one in
+// the table.
+//
+int FlatHashtableDB::Update(const string &table, const string &key,
+    vector<KVPair> &values) {
+  vmp::EpochGuard guard;
+  const char *key_index = KeyIndex(table, key);
+  while (true) {
+    FlatRecord *record = key_table_->Get(key_index);
+    if (!record) {
+      FlatRecord *fresh = NewRecord(values);
+      if (key_table_->Insert(key_index, fresh)) return DB::kOK;
+      DiscardRecord(fresh);
+      continue;
+    }
+
+    record->Lock();
+    if (record->obsolete()) {
+      record->Unlock();
+      continue;
+    }
+    if (record->Write(values)) {
+      record->Unlock();
+      ++thread_state->in_place_updates;
+      return DB::kOK;
+    }
+
+    FlatRecord *copy = NewRecord(record->Merge(values));
+    FlatRecord *old = key_table_->Update(key_index, copy);
+    assert(old == record);
+    record->set_obsolete();
+    record->Unlock();
+    RetireRecord(record);
+    ++thread_state->copied_updates;
+    return DB::kOK;
+  }
+}
+
+int FlatHashtableDB::Insert(const string &table, const string &key,
+    vector<KVPair> &values) {
+  vmp::EpochGuard guard;
+  FlatRecord *record = NewRecord(values);
+  if (!key_table_->Insert(KeyIndex(table, key), record)) {
+    DiscardRecord(record);
+    return DB::kErrorConflict;
+  }
+  return DB::kOK;
+}
+
+int FlatHashtableDB::Delete(const string &table, const string &key) {
+  vmp::EpochGuard guard;
+  const char *key_index = KeyIndex(table, key);
+  while (true) {
+    FlatRecord *record = key_table_->Get(key_index);
+    if (!record) return DB::kErrorNoData;
+
+    record->Lock();
+    if (record->obsolete()) {
+      record->Unlock();
+      continue;
+    }
+    FlatRecord *old = key_table_->Remove(key_index);
+    assert(old == record);
+    record->set_obsolete();
+    record->Unlock();
+    RetireRecord(record);
+    return DB::kOK;
+  }
+}
+
+//
+// Record bytes count the flat records alone; resident bytes, the whole
+// process, to compare with the field-table layout.
+//
+void FlatHashtableDB::PrintStats() {
+  std::lock_guard<std::mutex> lock(stats_mutex_);
+  size_t records = key_table_->Size();
+  if (records) {
+    cerr << "# Records:\t" << records << endl;
+    cerr << "# Record bytes per record:\t"
+         << (double)record_bytes_.load() / records << endl;
+    cerr << "# Resident bytes per record:\t"
+         << (double)HashtableDB::ResidentBytes() / records << endl;
+  }
+  if (in_place_updates_ + copied_updates_) {
+    cerr << "# Updates in place:\t" << in_place_updates_ << endl;
+    cerr << "# Updates copying the record:\t" << copied_updates_ << endl;
+  }
+  if (copy_latency_.Count()) {
+    cerr << "# Record read retries:\t" << read_retries_ << endl;
+    Measurements::PrintHeader(cerr, "Record copy");
+    Measurements::PrintHistogram(cerr, "READ", copy_latency_);
+  }
+  copy_latency_.Clear();
+  read_retries_ = 0;
+  in_place_updates_ = 0;
+  copied_updates_ = 0;
+}
+
+} // ycsbc
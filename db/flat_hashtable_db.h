@@ -0,0 +1,74 @@
+//
+//  flat_hashtable_db.h
+//  YCSB-C
+//
+
+#ifndef YCSB_C_FLAT_HASHTABLE_DB_H_
+#define YCSB_C_FLAT_HASHTABLE_DB_H_
+
+#include "core/db.h"
+
+#include <atomic>
+#include <mutex>
+#include <string>
+#include <vector>
+#include "core/histogram.h"
+#include "lib/flat_record.h"
+#include "lib/string_hashtable.h"
+
+namespace ycsbc {
+
+///
+/// Like HashtableDB, but each record is a single vmp::FlatRecord holding all
+/// of its fields, rather than a table of fields with a string per value.
+/// Reads take no locks, and updates whose values fit are made in place.
+///
+class FlatHashtableDB : public DB {
+ public:
+  typedef vmp::StringHashtable<vmp::FlatRecord *> KeyHashtable;
+
+  void Init();
+  void Close();
+
+  int Read(const std::string &table, const std::string &key,
+           const std::vector<std::string> *fields,
+           std::vector<KVPair> &result);
+  int Scan(const std::string &table, const std::string &key,
+           int len, const std::vector<std::string> *fields,
+           std::vector<std::vector<KVPair>> &result);
+  int Update(const std::string &table, const std::string &key,
+             std::vector<KVPair> &values);
+  int Insert(const std::string &table, const std::string &key,
+             std::vector<KVPair> &values);
+  int Delete(const std::string &table, const std::string &key);
+
+  void PrintStats();
+
+ protected:
+  FlatHashtableDB(KeyHashtable *table) : key_table_(table), record_bytes_(0) { }
+
+  virtual void *AllocateRecord(std::size_t size) = 0;
+  virtual void FreeRecord(vmp::FlatRecord *record) = 0;
+
+  KeyHashtable *key_table_;
+
+ private:
+  const char *KeyIndex(const std::string &table, const std::string &key);
+  vmp::FlatRecord *NewRecord(const std::vector<KVPair> &fields);
+  void DiscardRecord(vmp::FlatRecord *record);
+  void RetireRecord(vmp::FlatRecord *record);
+  static void FreeRetiredRecord(void *record, void *db);
+
+  std::atomic<int64_t> record_bytes_; // of the records in key_table_
+
+  // Per-thread counts, merged in Close()
+  std::mutex stats_mutex_;
+  utils::Histogram copy_latency_; // copying the fields out of a record
+  uint64_t read_retries_ = 0;
+  uint64_t in_place_updates_ = 0;
+  uint64_t copied_updates_ = 0;
+};
+
+} // ycsbc
+
+#endif // YCSB_C_FLAT_HASHTABLE_DB_H_
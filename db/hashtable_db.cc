@@ -8,10 +8,15 @@
 
 #include "db/hashtable_db.h"
 
+#include <fstream>
+#include <iostream>
 #include <string>
 #include <vector>
+#include <unistd.h>
 #include "lib/string_hashtable.h"
 
+using std::cerr;
+using std::endl;
 using std::string;
 using std::vector;
 using vmp::StringHashtable;
@@ -20,6 +25,7 @@ namespace ycsbc {
 
 int HashtableDB::Read(const string &table, const string &key,
     const vector<string> *fields, vector<KVPair> &result) {
+  vmp::EpochGuard guard;
   string key_index(table + key);
   FieldHashtable *field_table = key_table_->Get(key_index.c_str());
   if (!field_table) return DB::kErrorNoData;
@@ -42,6 +48,7 @@ int HashtableDB::Read(const string &table, const string &key,
 
 int HashtableDB::Scan(const string &table, const string &key, int len,
     const vector<string> *fields, vector<vector<KVPair>> &result) {
+  vmp::EpochGuard guard;
   string key_index(table + key);
   vector<KeyHashtable::KVPair> key_pairs =
       key_table_->Entries(key_index.c_str(), len);
@@ -72,6 +79,7 @@ int HashtableDB::Scan(const string &table, const string &key, int len,
 
 int HashtableDB::Update(const string &table, const string &key,
     vector<KVPair> &values) {
+  vmp::EpochGuard guard;
   string key_index(table + key);
   FieldHashtable *field_table = key_table_->Get(key_index.c_str());
   if (!field_table) {
@@ -88,7 +96,7 @@ int HashtableDB::Update(const string &table, const string &key,
       if (!old) {
         field_table->Insert(field_pair.first.c_str(), value);
       } else {
-        DeleteString(old);
+        RetireString(old);
       }
     }
   }
@@ -97,6 +105,7 @@ int HashtableDB::Update(const string &table, const string &key,
 
 int HashtableDB::Insert(const string &table, const string &key,
     vector<KVPair> &values) {
+  vmp::EpochGuard guard;
   string key_index(table + key);
   FieldHashtable *field_table = key_table_->Get(key_index.c_str());
   if (!field_table) {
@@ -116,14 +125,31 @@ int HashtableDB::Insert(const string &table, const string &key,
 }
 
 int HashtableDB::Delete(const string &table, const string &key) {
+  vmp::EpochGuard guard;
   string key_index(table + key);
   FieldHashtable *field_table = key_table_->Remove(key_index.c_str());
   if (!field_table) {
     return DB::kErrorNoData;
   } else {
-    DeleteFieldHashtable(field_table);
+    RetireFieldHashtable(field_table);
   }
   return DB::kOK;
 }
 
+void HashtableDB::PrintStats() {
+  size_t records = key_table_->Size();
+  if (records) {
+    cerr << "# Records:\t" << records << endl;
+    cerr << "# Resident bytes per record:\t"
+         << (double)ResidentBytes() / records << endl;
+  }
+}
+
+size_t HashtableDB::ResidentBytes() {
+  std::ifstream statm("/proc/self/statm");
+  size_t pages = 0, resident = 0;
+  statm >> pages >> resident;
+  return resident * sysconf(_SC_PAGESIZE);
+}
+
 } // ycsbc
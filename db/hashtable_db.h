@@ -13,6 +13,7 @@
 
 #include <string>
 #include <vector>
+#include "lib/epoch.h"
 #include "lib/string_hashtable.h"
 
 namespace ycsbc {
@@ -34,6 +35,13 @@ class HashtableDB : public DB {
              std::vector<KVPair> &values);
   int Delete(const std::string &table, const std::string &key);
 
+  void PrintStats();
+
+  ///
+  /// Resident memory of the whole process, from /proc/self/statm.
+  ///
+  static std::size_t ResidentBytes();
+
  protected:
   HashtableDB(KeyHashtable *table) : key_table_(table) { }
 
@@ -43,7 +51,27 @@ class HashtableDB : public DB {
   virtual const char *CopyString(const std::string &str) = 0;
   virtual void DeleteString(const char *str) = 0;
 
+  ///
+  /// Values and field tables that other threads may still be reading are
+  /// retired, and deleted once every operation that could have seen them
+  /// has finished. Destructors call vmp::Epoch::Drain() first.
+  ///
+  void RetireString(const char *str) {
+    vmp::Epoch::Retire((void *)str, &FreeString, this);
+  }
+  void RetireFieldHashtable(FieldHashtable *table) {
+    vmp::Epoch::Retire(table, &FreeFieldHashtable, this);
+  }
+
   KeyHashtable *key_table_;
+
+ private:
+  static void FreeString(void *str, void *db) {
+    ((HashtableDB *)db)->DeleteString((const char *)str);
+  }
+  static void FreeFieldHashtable(void *table, void *db) {
+    ((HashtableDB *)db)->DeleteFieldHashtable((FieldHashtable *)table);
+  }
 };
 
 } // ycsbc
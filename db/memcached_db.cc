@@ -0,0 +1,503 @@
+//
+//  memcached_db.cc
+//  YCSB-C
+//
+
+#include "db/memcached_db.h"
+
+#include <cstring>
+#include <cerrno>
+#include <chrono>
+#include <memory>
+#include <vector>
+#include <unistd.h>
+#include <netdb.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <arpa/inet.h>
+#include "core/core_workload.h"
+#include "core/measurements.h"
+#include "core/record_codec.h"
+
+using std::cerr;
+using std::string;
+using std::string_view;
+using std::vector;
+
+namespace ycsbc {
+
+//
+// A blocking socket with buffered writes and reads. Commands are appended
+// to out() and sent together by Send(), so a batch of them costs a single
+// system call.
+//
+class MemcachedConnection {
+ public:
+  MemcachedConnection(const string &host, int port, const string &unixsocket);
+  ~MemcachedConnection() { close(fd_); }
+
+  string &out() { return out_; }
+  void Send();
+
+  ///
+  /// The next line, without its "\r\n", or the next n bytes. Both stay
+  /// valid until the next read.
+  ///
+  string_view ReadLine();
+  string_view ReadBytes(size_t n);
+
+ private:
+  void Fill();
+
+  int fd_;
+  string out_;
+  string in_;
+  size_t in_pos_;
+};
+
+MemcachedConnection::MemcachedConnection(const string &host, int port,
+                                         const string &unixsocket) : in_pos_(0) {
+  if (!unixsocket.empty()) {
+    struct sockaddr_un addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    strncpy(addr.sun_path, unixsocket.c_str(), sizeof(addr.sun_path) - 1);
+    fd_ = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (fd_ < 0 || connect(fd_, (struct sockaddr *)&addr, sizeof(addr)) < 0) {
+      cerr << "Connect error: " << unixsocket << ": " << strerror(errno) << endl;
+      exit(1);
+    }
+    return;
+  }
+  struct addrinfo hints, *addrs;
+  memset(&hints, 0, sizeof(hints));
+  hints.ai_family = AF_UNSPEC;
+  hints.ai_socktype = SOCK_STREAM;
+  int rc = getaddrinfo(host.c_str(), std::to_string(port).c_str(), &hints, &addrs);
+  if (rc) {
+    cerr << "Connect error: " << host << ": " << gai_strerror(rc) << endl;
+    exit(1);
+  }
+  fd_ = -1;
+  for (struct addrinfo *a = addrs; a && fd_ < 0; a = a->ai_next) {
+    fd_ = socket(a->ai_family, a->ai_socktype, a->ai_protocol);
+    if (fd_ >= 0 && connect(fd_, a->ai_addr, a->ai_addrlen) < 0) {
+      close(fd_);
+      fd_ = -1;
+    }
+  }
+  freeaddrinfo(addrs);
+  if (fd_ < 0) {
+    cerr << "Connect error: " << host << ":" << port << ": " << strerror(errno) << endl;
+    exit(1);
+  }
+  int one = 1;
+  setsockopt(fd_, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+}
+
+void MemcachedConnection::Send() {
+  size_t sent = 0;
+  while (sent < out_.size()) {
+    ssize_t n = send(fd_, out_.data() + sent, out_.size() - sent, MSG_NOSIGNAL);
+    if (n < 0 && errno == EINTR) {
+      continue;
+    }
+    if (n <= 0) {
+      cerr << "Send error: " << strerror(errno) << endl;
+      exit(2);
+    }
+    sent += n;
+  }
+  out_.clear();
+}
+
+void MemcachedConnection::Fill() {
+  // Drop what has been consumed before reading more
+  if (in_pos_) {
+    in_.erase(0, in_pos_);
+    in_pos_ = 0;
+  }
+  char buffer[65536];
+  ssize_t n;
+  do {
+    n = recv(fd_, buffer, sizeof(buffer), 0);
+  } while (n < 0 && errno == EINTR);
+  if (n <= 0) {
+    cerr << "Receive error: " << (n ? strerror(errno) : "connection closed") << endl;
+    exit(2);
+  }
+  in_.append(buffer, n);
+}
+
+string_view MemcachedConnection::ReadLine() {
+  size_t end;
+  while ((end = in_.find("\r\n", in_pos_)) == string::npos) {
+    Fill();
+  }
+  string_view line(in_.data() + in_pos_, end - in_pos_);
+  in_pos_ = end + 2;
+  return line;
+}
+
+string_view MemcachedConnection::ReadBytes(size_t n) {
+  while (in_.size() - in_pos_ < n) {
+    Fill();
+  }
+  string_view bytes(in_.data() + in_pos_, n);
+  in_pos_ += n;
+  return bytes;
+}
+
+//
+// The binary protocol's request and response header, in network byte order.
+//
+struct BinaryHeader {
+  uint8_t magic;
+  uint8_t opcode;
+  uint16_t key_length;
+  uint8_t extras_length;
+  uint8_t data_type;
+  uint16_t status; // vbucket id in requests
+  uint32_t body_length;
+  uint32_t opaque;
+  uint64_t cas;
+} __attribute__((packed));
+
+static const uint8_t kRequestMagic = 0x80;
+static const uint8_t kGet = 0x00;
+static const uint8_t kSet = 0x01;
+static const uint8_t kDelete = 0x04;
+static const uint8_t kNoop = 0x0a;
+static const uint8_t kGetKQ = 0x0d;
+static const uint8_t kSetQ = 0x11;
+static const uint8_t kDeleteQ = 0x14;
+
+static void AppendBinary(string &out, uint8_t opcode, const string &key,
+                         const string *value = NULL, uint32_t opaque = 0) {
+  BinaryHeader header;
+  memset(&header, 0, sizeof(header));
+  header.magic = kRequestMagic;
+  header.opcode = opcode;
+  header.key_length = htons(key.size());
+  header.extras_length = value ? 8 : 0; // flags and expiration
+  header.body_length = htonl(header.extras_length + key.size() + (value ? value->size() : 0));
+  header.opaque = htonl(opaque);
+  out.append((const char *)&header, sizeof(header));
+  if (value) {
+    out.append(8, '\0');
+  }
+  out.append(key);
+  if (value) {
+    out.append(*value);
+  }
+}
+
+//
+// State private to each client thread, set up by Init() and torn down by
+// Close().
+//
+struct MemcachedThreadState {
+  std::unique_ptr<MemcachedConnection> conn;
+
+  // Value found by the last Get(), and the part of it that was asked for
+  string value;
+  string_view last_value;
+  bool found = false;
+
+  // Encoded record being written
+  string record;
+
+  uint32_t next_opaque = 0;
+  vector<uint64_t> batch_times; // when each batched write was issued
+  utils::Histogram write_latency;
+  utils::Histogram batch_latency;
+};
+
+static thread_local MemcachedThreadState *thread_state = NULL;
+
+static inline uint64_t NowNanos() {
+  return std::chrono::duration_cast<std::chrono::nanoseconds>(
+      std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+MemcachedDB::MemcachedDB(utils::Properties &props) :
+    host_(props["memcached.host"]), port_(props.GetIntProperty("memcached.port")),
+    unixsocket_(props["memcached.unixsocket"]),
+    field_count_(props.GetIntProperty(CoreWorkload::FIELD_COUNT_PROPERTY)),
+    batch_size_(props.GetIntProperty("memcached.batch_size")) {
+  string protocol = props["memcached.protocol"];
+  if (protocol == "binary") {
+    binary_ = true;
+  } else if (protocol == "text") {
+    binary_ = false;
+  } else {
+    cout << "Unknown memcached.protocol " << protocol << endl;
+    assert(0);
+  }
+}
+
+void MemcachedDB::Init() {
+  thread_state = new MemcachedThreadState();
+  thread_state->conn.reset(new MemcachedConnection(host_, port_, unixsocket_));
+}
+
+void MemcachedDB::Close() {
+  Flush();
+  {
+    std::lock_guard<std::mutex> lock(stats_mutex_);
+    write_latency_.Merge(thread_state->write_latency);
+    batch_latency_.Merge(thread_state->batch_latency);
+  }
+  delete thread_state;
+  thread_state = NULL;
+}
+
+//
+// Reads the value of key into the thread's state. Batched writes send no
+// replies, so the get's reply is the next one on the connection.
+//
+bool MemcachedDB::Get(const string &key) {
+  MemcachedThreadState *ts = thread_state;
+  MemcachedConnection *conn = ts->conn.get();
+  ts->found = false;
+  if (binary_) {
+    uint32_t opaque = ++ts->next_opaque;
+    AppendBinary(conn->out(), kGet, key, NULL, opaque);
+    conn->Send();
+    for (;;) {
+      BinaryHeader header;
+      memcpy(&header, conn->ReadBytes(sizeof(header)).data(), sizeof(header));
+      string_view body = conn->ReadBytes(ntohl(header.body_length));
+      // Quiet writes only reply when they fail
+      if (ntohl(header.opaque) != opaque) {
+        continue;
+      }
+      if (header.status == 0) {
+        ts->value.assign(body.substr(header.extras_length + ntohs(header.key_length)));
+        ts->found = true;
+      }
+      return ts->found;
+    }
+  }
+  conn->out().append("get ").append(key).append("\r\n");
+  conn->Send();
+  for (;;) {
+    string_view line = conn->ReadLine();
+    if (line == "END") {
+      return ts->found;
+    }
+    // VALUE <key> <flags> <bytes>
+    assert(line.substr(0, 6) == "VALUE ");
+    size_t bytes = strtoull(line.data() + line.rfind(' ') + 1, NULL, 10);
+    ts->value.assign(conn->ReadBytes(bytes + 2).substr(0, bytes));
+    ts->found = true;
+  }
+}
+
+void MemcachedDB::Set(const string &key, const string &value) {
+  MemcachedConnection *conn = thread_state->conn.get();
+  bool noreply = batch_size_ > 1;
+  if (binary_) {
+    AppendBinary(conn->out(), noreply ? kSetQ : kSet, key, &value);
+  } else {
+    conn->out().append("set ").append(key).append(" 0 0 ")
+        .append(std::to_string(value.size())).append(noreply ? " noreply\r\n" : "\r\n")
+        .append(value).append("\r\n");
+  }
+  Written();
+}
+
+//
+// Unbatched writes are sent at once and wait for their reply. Batched ones
+// stay in the connection's buffer, and Flush() sends the whole batch, with
+// the command acknowledging it, in one go (as does any read before then).
+//
+void MemcachedDB::Written() {
+  MemcachedThreadState *ts = thread_state;
+  MemcachedConnection *conn = ts->conn.get();
+  if (batch_size_ <= 1) {
+    conn->Send();
+    if (binary_) {
+      BinaryHeader header;
+      memcpy(&header, conn->ReadBytes(sizeof(header)).data(), sizeof(header));
+      conn->ReadBytes(ntohl(header.body_length));
+    } else {
+      conn->ReadLine();
+    }
+    return;
+  }
+  ts->batch_times.push_back(NowNanos());
+  if (ts->batch_times.size() >= batch_size_) {
+    Flush();
+  }
+}
+
+//
+// A no-op is answered after every write sent before it, so its reply
+// acknowledges the whole batch.
+//
+void MemcachedDB::Flush() {
+  MemcachedThreadState *ts = thread_state;
+  MemcachedConnection *conn = ts->conn.get();
+  if (ts->batch_times.empty()) {
+    return;
+  }
+  if (binary_) {
+    uint32_t opaque = ++ts->next_opaque;
+    AppendBinary(conn->out(), kNoop, string(), NULL, opaque);
+    conn->Send();
+    for (;;) {
+      BinaryHeader header;
+      memcpy(&header, conn->ReadBytes(sizeof(header)).data(), sizeof(header));
+      conn->ReadBytes(ntohl(header.body_length));
+      if (ntohl(header.opaque) == opaque) {
+        break;
+      }
+    }
+  } else {
+    conn->out().append("version\r\n");
+    conn->Send();
+    while (conn->ReadLine().substr(0, 8) != "VERSION ") { }
+  }
+  uint64_t now = NowNanos();
+  for (uint64_t issued : ts->batch_times) {
+    ts->write_latency.Add(now - issued);
+  }
+  ts->batch_latency.Add(now - ts->batch_times[0]);
+  ts->batch_times.clear();
+}
+
+int MemcachedDB::Read(const string &table, const string &key,
+                      const vector<string> *fields,
+                      vector<KVPair> &result) {
+  MemcachedThreadState *ts = thread_state;
+  if (Get(key)) {
+    // A single requested field is handed back on its own
+    string_view record(ts->value);
+    size_t index;
+    if (fields && fields->size() == 1) {
+      RecordCodec::FieldView field;
+      ts->found = RecordCodec::Find(record, (*fields)[0], index) &&
+          RecordCodec::Field(record, index, field);
+      if (ts->found) {
+        record = field.second;
+      }
+    }
+    ts->last_value = record;
+  }
+  return DB::kOK;
+}
+
+bool MemcachedDB::LastValue(string_view &value) {
+  if (!thread_state->found) {
+    return false;
+  }
+  value = thread_state->last_value;
+  return true;
+}
+
+//
+// All the keys are asked for in one multi-key get, or one quiet get each
+// followed by a no-op in the binary protocol, which only answers hits.
+//
+int MemcachedDB::MultiRead(const string &table,
+                           const vector<string> &keys,
+                           const vector<string> *fields,
+                           vector<vector<KVPair>> &result) {
+  MemcachedThreadState *ts = thread_state;
+  MemcachedConnection *conn = ts->conn.get();
+  if (binary_) {
+    uint32_t opaque = ts->next_opaque + keys.size() + 1;
+    for (const string &key : keys) {
+      AppendBinary(conn->out(), kGetKQ, key, NULL, ++ts->next_opaque);
+    }
+    AppendBinary(conn->out(), kNoop, string(), NULL, ++ts->next_opaque);
+    conn->Send();
+    for (;;) {
+      BinaryHeader header;
+      memcpy(&header, conn->ReadBytes(sizeof(header)).data(), sizeof(header));
+      conn->ReadBytes(ntohl(header.body_length));
+      if (ntohl(header.opaque) == opaque) {
+        break;
+      }
+    }
+    return DB::kOK;
+  }
+  conn->out().append("get");
+  for (const string &key : keys) {
+    conn->out().append(" ").append(key);
+  }
+  conn->out().append("\r\n");
+  conn->Send();
+  for (;;) {
+    string_view line = conn->ReadLine();
+    if (line == "END") {
+      break;
+    }
+    assert(line.substr(0, 6) == "VALUE ");
+    size_t bytes = strtoull(line.data() + line.rfind(' ') + 1, NULL, 10);
+    conn->ReadBytes(bytes + 2);
+  }
+  return DB::kOK;
+}
+
+//
+// Updates of some of the fields read the record, patch it and set it back.
+//
+int MemcachedDB::Update(const string &table, const string &key,
+                        vector<KVPair> &values) {
+  if (values.size() >= field_count_) {
+    return Insert(table, key, values);
+  }
+  MemcachedThreadState *ts = thread_state;
+  if (Get(key)) {
+    ts->record.swap(ts->value);
+    RecordCodec::Patch(ts->record, values);
+  } else {
+    RecordCodec::Encode(values, ts->record);
+  }
+  ts->found = false;
+  Set(key, ts->record);
+  return DB::kOK;
+}
+
+int MemcachedDB::Insert(const string &table, const string &key,
+                        vector<KVPair> &values) {
+  RecordCodec::Encode(values, thread_state->record);
+  Set(key, thread_state->record);
+  return DB::kOK;
+}
+
+int MemcachedDB::Delete(const string &table, const string &key) {
+  MemcachedConnection *conn = thread_state->conn.get();
+  bool noreply = batch_size_ > 1;
+  if (binary_) {
+    AppendBinary(conn->out(), noreply ? kDeleteQ : kDelete, key);
+  } else {
+    conn->out().append("delete ").append(key).append(noreply ? " noreply\r\n" : "\r\n");
+  }
+  Written();
+  return DB::kOK;
+}
+
+//
+// A batched write's latency is the time until the no-op sent after its
+// batch was answered.
+//
+void MemcachedDB::PrintStats() {
+  std::lock_guard<std::mutex> lock(stats_mutex_);
+  if (batch_latency_.Count()) {
+    cerr << "# Memcached write batches:\t" << batch_latency_.Count() << endl;
+    cerr << "# Memcached writes per batch:\t"
+         << (double)write_latency_.Count() / batch_latency_.Count() << endl;
+    Measurements::PrintHeader(cerr, "Memcached time to acknowledge");
+    Measurements::PrintHistogram(cerr, "WRITE", write_latency_);
+    Measurements::PrintHistogram(cerr, "BATCH", batch_latency_);
+  }
+  write_latency_.Clear();
+  batch_latency_.Clear();
+}
+
+} // ycsbc
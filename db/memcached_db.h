@@ -0,0 +1,88 @@
+//
+//  memcached_db.h
+//  YCSB-C
+//
+
+#ifndef YCSB_C_MEMCACHED_DB_H_
+#define YCSB_C_MEMCACHED_DB_H_
+
+#include "core/db.h"
+
+#include <iostream>
+#include <string>
+#include <mutex>
+#include "core/properties.h"
+#include "core/histogram.h"
+
+using std::cout;
+using std::endl;
+
+namespace ycsbc {
+
+class MemcachedConnection;
+
+///
+/// memcached, spoken to directly over TCP or a Unix-domain socket, in its
+/// text or binary protocol. Each thread has its own connection. Records are
+/// stored as a single value encoded with RecordCodec.
+///
+class MemcachedDB : public DB {
+ public:
+  MemcachedDB(utils::Properties &props);
+
+  void Init();
+  void Close();
+
+  int Read(const std::string &table, const std::string &key,
+           const std::vector<std::string> *fields,
+           std::vector<KVPair> &result);
+
+  bool LastValue(std::string_view &value);
+
+  int MultiRead(const std::string &table,
+                const std::vector<std::string> &keys,
+                const std::vector<std::string> *fields,
+                std::vector<std::vector<KVPair>> &result);
+
+  int Scan(const std::string &table, const std::string &key,
+           int len, const std::vector<std::string> *fields,
+           std::vector<std::vector<KVPair>> &result) {
+    throw "Scan: function not implemented!";
+  }
+
+  int Update(const std::string &table, const std::string &key,
+             std::vector<KVPair> &values);
+
+  int Insert(const std::string &table, const std::string &key,
+             std::vector<KVPair> &values);
+
+  int Delete(const std::string &table, const std::string &key);
+
+  void PrintStats();
+
+ private:
+  bool Get(const std::string &key);
+  void Set(const std::string &key, const std::string &value);
+  void Written();
+  void Flush();
+
+  std::string host_;
+  int port_;
+  std::string unixsocket_; // used instead of host_ and port_ when set
+  bool binary_;            // memcached.protocol is "binary" rather than "text"
+
+  // Updates of fewer than field_count fields read, patch and set the record
+  size_t field_count_;
+
+  // With memcached.batch_size above 1, writes are sent without asking for
+  // a reply (noreply, or quiet binary commands), and after each batch a
+  // no-op is waited for; the latencies are merged in Close()
+  size_t batch_size_;
+  std::mutex stats_mutex_;
+  utils::Histogram write_latency_;
+  utils::Histogram batch_latency_;
+};
+
+} // ycsbc
+
+#endif // YCSB_C_MEMCACHED_DB_H_
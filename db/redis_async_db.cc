@@ -0,0 +1,129 @@
+//
+//  redis_async_db.cc
+//  YCSB-C
+//
+
+#include "redis_async_db.h"
+
+#include <memory>
+#include "core/measurements.h"
+#include "redis/redis_client.h"
+
+using namespace std;
+
+namespace ycsbc {
+
+//
+// State private to each client thread, set up by Init() and torn down by
+// Close(): its connection, and the latencies of its commands.
+//
+struct RedisAsyncThreadState {
+  std::unique_ptr<RedisAsyncClient> client;
+  RedisArgv argv;
+  utils::Histogram latency[NUM_OPERATIONS];
+  utils::Histogram in_flight;
+};
+
+static thread_local RedisAsyncThreadState *thread_state = NULL;
+
+RedisAsyncDB::RedisAsyncDB(utils::Properties &props) :
+    host_(props["host"]), port_(stoi(props["port"])),
+    unixsocket_(props["redis.unixsocket"]),
+    async_depth_(props.GetIntProperty("redis.async_depth")) {
+  assert(async_depth_ > 0);
+}
+
+void RedisAsyncDB::Init() {
+  thread_state = new RedisAsyncThreadState();
+  if (!unixsocket_.empty()) {
+    thread_state->client.reset(new RedisAsyncClient(unixsocket_.c_str(), async_depth_));
+  } else {
+    thread_state->client.reset(new RedisAsyncClient(host_.c_str(), port_, async_depth_));
+  }
+}
+
+void RedisAsyncDB::Close() {
+  thread_state->client->Drain();
+  {
+    std::lock_guard<std::mutex> lock(stats_mutex_);
+    for (int i = 0; i < NUM_OPERATIONS; i++) {
+      latency_[i].Merge(thread_state->latency[i]);
+    }
+    in_flight_.Merge(thread_state->in_flight);
+  }
+  delete thread_state;
+  thread_state = NULL;
+}
+
+int RedisAsyncDB::Read(const string &table, const string &key,
+         const vector<string> *fields,
+         vector<KVPair> &result) {
+  RedisArgv &args = thread_state->argv;
+  args.Start(fields ? "HMGET" : "HGETALL");
+  args.Add(key);
+  if (fields) {
+    for (const string &f : *fields) {
+      args.Add(f);
+    }
+  }
+  thread_state->in_flight.Add(thread_state->client->in_flight());
+  thread_state->client->Send(args.argc(), args.argv(), args.argvlen(),
+                             &thread_state->latency[READ]);
+  return DB::kOK;
+}
+
+int RedisAsyncDB::Write(Operation op, const string &key, vector<KVPair> &values) {
+  RedisArgv &args = thread_state->argv;
+  args.Start("HMSET");
+  args.Add(key);
+  for (KVPair &p : values) {
+    args.Add(p.first);
+    args.Add(p.second);
+  }
+  thread_state->in_flight.Add(thread_state->client->in_flight());
+  thread_state->client->Send(args.argc(), args.argv(), args.argvlen(),
+                             &thread_state->latency[op]);
+  return DB::kOK;
+}
+
+int RedisAsyncDB::Update(const string &table, const string &key,
+           vector<KVPair> &values) {
+  return Write(UPDATE, key, values);
+}
+
+int RedisAsyncDB::Insert(const string &table, const string &key,
+           vector<KVPair> &values) {
+  return Write(INSERT, key, values);
+}
+
+//
+// Deletes have no operation of their own, so they are not timed.
+//
+int RedisAsyncDB::Delete(const string &table, const string &key) {
+  RedisArgv &args = thread_state->argv;
+  args.Start("DEL");
+  args.Add(key);
+  thread_state->client->Send(args.argc(), args.argv(), args.argvlen(), NULL);
+  return DB::kOK;
+}
+
+//
+// The client's own latencies only cover sending each command; these run
+// until its reply.
+//
+void RedisAsyncDB::PrintStats() {
+  std::lock_guard<std::mutex> lock(stats_mutex_);
+  Measurements::PrintHeader(cerr, "Redis time to reply");
+  for (int i = 0; i < NUM_OPERATIONS; i++) {
+    if (latency_[i].Count()) {
+      Measurements::PrintHistogram(cerr, OperationName((Operation)i), latency_[i]);
+    }
+    latency_[i].Clear();
+  }
+  if (in_flight_.Count()) {
+    cerr << "# Redis commands in flight per send:\t" << in_flight_.Mean() << endl;
+  }
+  in_flight_.Clear();
+}
+
+} // namespace ycsbc
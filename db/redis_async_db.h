@@ -0,0 +1,74 @@
+//
+//  redis_async_db.h
+//  YCSB-C
+//
+
+#ifndef YCSB_C_REDIS_ASYNC_DB_H_
+#define YCSB_C_REDIS_ASYNC_DB_H_
+
+#include "core/db.h"
+
+#include <iostream>
+#include <string>
+#include <mutex>
+#include "core/properties.h"
+#include "core/histogram.h"
+#include "core/core_workload.h"
+#include "redis/redis_async_client.h"
+
+using std::cout;
+using std::endl;
+
+namespace ycsbc {
+
+///
+/// Redis through hiredis's asynchronous API. Each operation only sends its
+/// command, so a thread keeps up to redis.async_depth commands in flight,
+/// and the latency from sending to the reply is recorded when it arrives.
+/// Reads therefore return no fields.
+///
+class RedisAsyncDB : public DB {
+ public:
+  RedisAsyncDB(utils::Properties &props);
+
+  void Init();
+  void Close();
+
+  int Read(const std::string &table, const std::string &key,
+           const std::vector<std::string> *fields,
+           std::vector<KVPair> &result);
+
+  int Scan(const std::string &table, const std::string &key,
+           int len, const std::vector<std::string> *fields,
+           std::vector<std::vector<KVPair>> &result) {
+    throw "Scan: function not implemented!";
+  }
+
+  int Update(const std::string &table, const std::string &key,
+             std::vector<KVPair> &values);
+
+  int Insert(const std::string &table, const std::string &key,
+             std::vector<KVPair> &values);
+
+  int Delete(const std::string &table, const std::string &key);
+
+  void PrintStats();
+
+ private:
+  int Write(Operation op, const std::string &key, std::vector<KVPair> &values);
+
+  std::string host_;
+  int port_;
+  std::string unixsocket_; // used instead of host_ and port_ when set
+  size_t async_depth_;
+
+  // Latency from sending each command to its reply, per operation, and the
+  // number of commands in flight when each was sent; merged in Close()
+  std::mutex stats_mutex_;
+  utils::Histogram latency_[NUM_OPERATIONS];
+  utils::Histogram in_flight_;
+};
+
+} // ycsbc
+
+#endif // YCSB_C_REDIS_ASYNC_DB_H_
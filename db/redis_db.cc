@@ -6,69 +6,417 @@
 #include "redis_db.h"
 
 #include <cstring>
+#include <chrono>
+#include <sstream>
+#include <algorithm>
+#include "core/measurements.h"
 
 using namespace std;
 
 namespace ycsbc {
 
-int RedisDB::Read(const string &table, const string &key,
-         const vector<string> *fields,
-         vector<KVPair> &result) {
+//
+// State private to each client thread, set up by Init() and torn down by
+// Close(). hiredis contexts are not thread-safe, so each thread connects to
+// each server on its own, unless the threads share pools of connections.
+//
+struct RedisThreadState {
+  vector<RedisClient *> clients; // per server
+
+  // Each thread builds its commands in the same arrays, so no command is
+  // formatted or allocates
+  RedisArgv argv;
+  std::string index_key;
+  std::string scan_start;
+  std::string scan_count;
+  vector<pair<string, size_t>> scan_keys; // with their server
+  vector<size_t> scan_order;
+
+  vector<uint64_t> shard_ops;
+  uint64_t routing_ns = 0;
+
+  utils::Histogram index_add_latency;
+  utils::Histogram index_remove_latency;
+};
+
+static thread_local RedisThreadState *thread_state = NULL;
+
+static inline uint64_t NowNanos() {
+  return std::chrono::duration_cast<std::chrono::nanoseconds>(
+      std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+//
+// Servers are listed as host:port or as the path of a Unix-domain socket,
+// separated by commas.
+//
+static void ParseServers(const string &list, vector<string> &servers) {
+  stringstream stream(list);
+  string server;
+  while (getline(stream, server, ',')) {
+    if (!server.empty()) {
+      servers.push_back(server);
+    }
+  }
+}
+
+static size_t CountServers(utils::Properties &props) {
+  vector<string> servers;
+  ParseServers(props["redis.servers"], servers);
+  return max(servers.size(), (size_t)1);
+}
+
+RedisDB::RedisDB(utils::Properties &props) :
+    router_(CountServers(props), props["redis.sharding"]),
+    slaves_(stoi(props["slaves"])),
+    pipeline_depth_(props.GetIntProperty("redis.pipeline")), routing_ns_(0),
+    scan_index_(props.GetIntProperty("redis.scan_index")) {
+  vector<string> servers;
+  ParseServers(props["redis.servers"], servers);
+  for (const string &server : servers) {
+    size_t colon = server.rfind(':');
+    if (server.find('/') != string::npos) {
+      servers_.push_back(Server{ "", 0, server });
+    } else if (colon != string::npos) {
+      servers_.push_back(Server{ server.substr(0, colon), stoi(server.substr(colon + 1)), "" });
+    } else {
+      cout << "Unknown redis.servers entry " << server << endl;
+      assert(0);
+    }
+  }
+  if (servers_.empty()) {
+    servers_.push_back(Server{ props["host"], stoi(props["port"]), props["redis.unixsocket"] });
+  }
+  if (!router_.valid()) {
+    cout << "Unknown redis.sharding " << props["redis.sharding"] << endl;
+    assert(0);
+  }
+  command_latency_.resize(servers_.size());
+  batch_latency_.resize(servers_.size());
+  shard_ops_.resize(servers_.size());
+
+  int pool_size = props.GetIntProperty("redis.pool_size");
+  if (pool_size > 0 && pipeline_depth_ > 1) {
+    cout << "redis.pipeline needs a connection per thread, not redis.pool_size" << endl;
+    assert(0);
+  }
+  if (pool_size > 0) {
+    for (size_t shard = 0; shard < servers_.size(); shard++) {
+      pools_.push_back(new RedisClientPool());
+      for (int i = 0; i < pool_size; i++) {
+        pools_[shard]->Add(NewClient(shard));
+      }
+    }
+  }
+}
+
+RedisDB::~RedisDB() {
+  for (RedisClientPool *pool : pools_) {
+    delete pool;
+  }
+}
+
+RedisClient *RedisDB::NewClient(size_t shard) {
+  const Server &server = servers_[shard];
+  if (!server.unixsocket.empty()) {
+    return new RedisClient(server.unixsocket.c_str(), slaves_);
+  }
+  return new RedisClient(server.host.c_str(), server.port, slaves_);
+}
+
+void RedisDB::Init() {
+  thread_state = new RedisThreadState();
+  thread_state->shard_ops.resize(servers_.size());
+  if (pools_.empty()) {
+    for (size_t shard = 0; shard < servers_.size(); shard++) {
+      thread_state->clients.push_back(NewClient(shard));
+      thread_state->clients[shard]->set_pipeline_depth(pipeline_depth_);
+    }
+  }
+}
+
+void RedisDB::Close() {
+  for (RedisClient *client : thread_state->clients) {
+    client->Flush();
+  }
+  {
+    std::lock_guard<std::mutex> lock(stats_mutex_);
+    for (size_t shard = 0; shard < thread_state->clients.size(); shard++) {
+      command_latency_[shard].Merge(thread_state->clients[shard]->command_latency());
+      batch_latency_[shard].Merge(thread_state->clients[shard]->batch_latency());
+    }
+    for (size_t shard = 0; shard < servers_.size(); shard++) {
+      shard_ops_[shard] += thread_state->shard_ops[shard];
+    }
+    routing_ns_ += thread_state->routing_ns;
+    index_add_latency_.Merge(thread_state->index_add_latency);
+    index_remove_latency_.Merge(thread_state->index_remove_latency);
+  }
+  for (RedisClient *client : thread_state->clients) {
+    delete client;
+  }
+  delete thread_state;
+  thread_state = NULL;
+}
+
+RedisDB::Connection::Connection(RedisDB &db, size_t shard) :
+    pool_(db.pools_.empty() ? NULL : db.pools_[shard]) {
+  client_ = pool_ ? pool_->Acquire() : thread_state->clients[shard];
+  assert(client_);
+}
+
+RedisDB::Connection::~Connection() {
+  if (pool_) {
+    pool_->Release(client_);
+  }
+}
+
+size_t RedisDB::Route(const string &key) {
+  if (servers_.size() == 1) {
+    thread_state->shard_ops[0]++;
+    return 0;
+  }
+  uint64_t start = NowNanos();
+  size_t shard = router_.Route(key);
+  thread_state->routing_ns += NowNanos() - start;
+  thread_state->shard_ops[shard]++;
+  return shard;
+}
+
+//
+// Replies are copied with their length, so values may hold any bytes.
+//
+static inline string ReplyString(const redisReply *reply) {
+  return reply->str ? string(reply->str, reply->len) : string();
+}
+
+static void StartRead(RedisArgv &args, const char *key, size_t key_len,
+                      const vector<string> *fields) {
+  args.Start(fields ? "HMGET" : "HGETALL");
+  args.Add(key, key_len);
   if (fields) {
-    int argc = fields->size() + 2;
-    const char *argv[argc];
-    size_t argvlen[argc];
-    int i = 0;
-    argv[i] = "HMGET"; argvlen[i] = strlen(argv[i]);
-    argv[++i] = key.c_str(); argvlen[i] = key.length();
     for (const string &f : *fields) {
-      argv[++i] = f.data(); argvlen[i] = f.size();
+      args.Add(f);
     }
-    assert(i == argc - 1);
-    redisReply *reply = (redisReply *)redisCommandArgv(
-        redis_.context(), argc, argv, argvlen);
-    if (!reply) return DB::kOK;
-    assert(reply->type == REDIS_REPLY_ARRAY);
+  }
+}
+
+static void ReadReply(const redisReply *reply, const vector<string> *fields,
+                      vector<DB::KVPair> &result) {
+  assert(reply->type == REDIS_REPLY_ARRAY);
+  if (fields) {
     assert(fields->size() == reply->elements);
     for (size_t i = 0; i < reply->elements; ++i) {
-      const char *value = reply->element[i]->str;
-      result.push_back(make_pair(fields->at(i), string(value ? value : "")));
+      result.push_back(make_pair(fields->at(i), ReplyString(reply->element[i])));
     }
-    freeReplyObject(reply);
   } else {
-    redisReply *reply = (redisReply *)redisCommand(redis_.context(),
-        "HGETALL %s", key.c_str());
-    if (!reply) return DB::kOK;
-    assert(reply->type == REDIS_REPLY_ARRAY);
     for (size_t i = 0; i < reply->elements / 2; ++i) {
       result.push_back(make_pair(
-          string(reply->element[2 * i]->str),
-          string(reply->element[2 * i + 1]->str)));
+          ReplyString(reply->element[2 * i]),
+          ReplyString(reply->element[2 * i + 1])));
+    }
+  }
+}
+
+static inline const string &IndexKey(const string &table) {
+  thread_state->index_key.assign(table).append(".index");
+  return thread_state->index_key;
+}
+
+int RedisDB::Read(const string &table, const string &key,
+         const vector<string> *fields,
+         vector<KVPair> &result) {
+  Connection conn(*this, Route(key));
+  // The read's reply comes after those of the queued writes
+  conn->Flush();
+  RedisArgv &args = thread_state->argv;
+  StartRead(args, key.data(), key.size(), fields);
+  redisReply *reply = (redisReply *)redisCommandArgv(
+      conn->context(), args.argc(), args.argv(), args.argvlen());
+  if (!reply) return DB::kOK;
+  ReadReply(reply, fields, result);
+  freeReplyObject(reply);
+  return DB::kOK;
+}
+
+//
+// Each server indexes its own keys. The first len keys of every server's
+// index are read with ZRANGEBYLEX, merged, and the first len of them read
+// with one pipelined batch of HGETALLs per server. Servers are queried in
+// turn.
+//
+int RedisDB::Scan(const string &table, const string &key,
+         int len, const vector<string> *fields,
+         vector<vector<KVPair>> &result) {
+  if (!scan_index_) {
+    throw "Scan: function not implemented without redis.scan_index!";
+  }
+  RedisArgv &args = thread_state->argv;
+  vector<pair<string, size_t>> &keys = thread_state->scan_keys;
+  keys.clear();
+  thread_state->scan_start.assign("[").append(key);
+  thread_state->scan_count = to_string(len);
+  for (size_t shard = 0; shard < servers_.size(); shard++) {
+    Connection conn(*this, shard);
+    conn->Flush();
+    args.Start("ZRANGEBYLEX");
+    args.Add(IndexKey(table));
+    args.Add(thread_state->scan_start);
+    args.Add("+", 1);
+    args.Add("LIMIT", 5);
+    args.Add("0", 1);
+    args.Add(thread_state->scan_count);
+    redisReply *reply = (redisReply *)redisCommandArgv(
+        conn->context(), args.argc(), args.argv(), args.argvlen());
+    if (!reply) return DB::kOK;
+    assert(reply->type == REDIS_REPLY_ARRAY);
+    for (size_t i = 0; i < reply->elements; ++i) {
+      keys.emplace_back(ReplyString(reply->element[i]), shard);
     }
     freeReplyObject(reply);
   }
+  if (servers_.size() > 1) {
+    sort(keys.begin(), keys.end());
+  }
+  if (keys.size() > (size_t)len) {
+    keys.resize(len);
+  }
+
+  size_t first = result.size();
+  result.resize(first + keys.size());
+  vector<size_t> &order = thread_state->scan_order;
+  for (size_t shard = 0; shard < servers_.size(); shard++) {
+    Connection conn(*this, shard);
+    order.clear();
+    for (size_t i = 0; i < keys.size(); ++i) {
+      if (keys[i].second == shard) {
+        StartRead(args, keys[i].first.data(), keys[i].first.size(), fields);
+        redisAppendCommandArgv(conn->context(), args.argc(), args.argv(), args.argvlen());
+        order.push_back(i);
+      }
+    }
+    for (size_t i : order) {
+      redisReply *reply;
+      if (redisGetReply(conn->context(), (void **)&reply) == REDIS_ERR) {
+        return DB::kOK;
+      }
+      ReadReply(reply, fields, result[first + i]);
+      freeReplyObject(reply);
+    }
+  }
   return DB::kOK;
 }
 
 int RedisDB::Update(const string &table, const string &key,
            vector<KVPair> &values) {
-  string cmd("HMSET");
-  size_t len = cmd.length() + key.length() + 1;
+  RedisArgv &args = thread_state->argv;
+  args.Start("HMSET");
+  args.Add(key);
   for (KVPair &p : values) {
-    len += p.first.length() + p.second.length() + 2;
+    args.Add(p.first);
+    args.Add(p.second);
   }
-  cmd.reserve(len);
+  Connection conn(*this, Route(key));
+  conn->Append(args.argc(), args.argv(), args.argvlen());
+  return DB::kOK;
+}
 
-  cmd.append(" ").append(key);
+//
+// New keys are added to their server's index in the same pipeline as their
+// record.
+//
+int RedisDB::Insert(const string &table, const string &key,
+           vector<KVPair> &values) {
+  if (!scan_index_) {
+    return Update(table, key, values);
+  }
+  RedisArgv &args = thread_state->argv;
+  args.Start("HMSET");
+  args.Add(key);
   for (KVPair &p : values) {
-    assert(p.first.find(' ') == string::npos);
-    cmd.append(" ").append(p.first);
-    assert(p.second.find(' ') == string::npos);
-    cmd.append(" ").append(p.second);
+    args.Add(p.first);
+    args.Add(p.second);
   }
-  assert(cmd.length() == len);
-  redis_.Command(cmd);
+  Connection conn(*this, Route(key));
+  conn->Queue(args.argc(), args.argv(), args.argvlen());
+  args.Start("ZADD");
+  args.Add(IndexKey(table));
+  args.Add("0", 1);
+  args.Add(key);
+  conn->Append(args.argc(), args.argv(), args.argvlen(), &thread_state->index_add_latency);
   return DB::kOK;
 }
 
+int RedisDB::Delete(const string &table, const string &key) {
+  RedisArgv &args = thread_state->argv;
+  args.Start("DEL");
+  args.Add(key);
+  Connection conn(*this, Route(key));
+  if (!scan_index_) {
+    conn->Append(args.argc(), args.argv(), args.argvlen());
+    return DB::kOK;
+  }
+  conn->Queue(args.argc(), args.argv(), args.argvlen());
+  args.Start("ZREM");
+  args.Add(IndexKey(table));
+  args.Add(key);
+  conn->Append(args.argc(), args.argv(), args.argvlen(), &thread_state->index_remove_latency);
+  return DB::kOK;
+}
+
+//
+// A write's latency is the time until the reply of its batch, including
+// the batch's WAIT, was read. The index's cost is the time each ZADD or ZREM
+// added after the reply to the write it followed.
+//
+void RedisDB::PrintStats() {
+  std::lock_guard<std::mutex> lock(stats_mutex_);
+  utils::Histogram command_latency, batch_latency;
+  uint64_t ops = 0;
+  for (size_t shard = 0; shard < servers_.size(); shard++) {
+    command_latency.Merge(command_latency_[shard]);
+    batch_latency.Merge(batch_latency_[shard]);
+    ops += shard_ops_[shard];
+  }
+  if (pipeline_depth_ > 1 && batch_latency.Count()) {
+    cerr << "# Redis pipeline batches:\t" << batch_latency.Count() << endl;
+    cerr << "# Redis commands per batch:\t"
+         << (double)command_latency.Count() / batch_latency.Count() << endl;
+    Measurements::PrintHeader(cerr, "Redis time to reply");
+    Measurements::PrintHistogram(cerr, "WRITE", command_latency);
+    Measurements::PrintHistogram(cerr, "BATCH", batch_latency);
+  }
+  if (index_add_latency_.Count() || index_remove_latency_.Count()) {
+    Measurements::PrintHeader(cerr, "Redis index maintenance");
+    if (index_add_latency_.Count()) {
+      Measurements::PrintHistogram(cerr, "ZADD", index_add_latency_);
+    }
+    if (index_remove_latency_.Count()) {
+      Measurements::PrintHistogram(cerr, "ZREM", index_remove_latency_);
+    }
+  }
+  if (servers_.size() > 1 && ops) {
+    cerr << "# Redis routing time per operation (ns):\t" << (double)routing_ns_ / ops << endl;
+    cerr << "# Redis shard\toperations\tshare" << endl;
+    for (size_t shard = 0; shard < servers_.size(); shard++) {
+      cerr << "#\t" << shard << '\t' << shard_ops_[shard]
+           << '\t' << (double)shard_ops_[shard] / ops << endl;
+    }
+    if (pipeline_depth_ > 1 && batch_latency.Count()) {
+      Measurements::PrintHeader(cerr, "Redis time to reply per shard");
+      for (size_t shard = 0; shard < servers_.size(); shard++) {
+        Measurements::PrintHistogram(cerr, to_string(shard), command_latency_[shard]);
+      }
+    }
+  }
+  for (size_t shard = 0; shard < servers_.size(); shard++) {
+    command_latency_[shard].Clear();
+    batch_latency_[shard].Clear();
+    shard_ops_[shard] = 0;
+  }
+  routing_ns_ = 0;
+  index_add_latency_.Clear();
+  index_remove_latency_.Clear();
+}
+
 } // namespace ycsbc
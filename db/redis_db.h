@@ -10,8 +10,12 @@
 
 #include <iostream>
 #include <string>
+#include <mutex>
+#include <vector>
 #include "core/properties.h"
+#include "core/histogram.h"
 #include "redis/redis_client.h"
+#include "redis/redis_router.h"
 #include "redis/hiredis/hiredis.h"
 
 using std::cout;
@@ -21,9 +25,11 @@ namespace ycsbc {
 
 class RedisDB : public DB {
  public:
-  RedisDB(const char *host, int port, int slaves) :
-      redis_(host, port, slaves) {
-  }
+  RedisDB(utils::Properties &props);
+  ~RedisDB();
+
+  void Init();
+  void Close();
 
   int Read(const std::string &table, const std::string &key,
            const std::vector<std::string> *fields,
@@ -31,26 +37,71 @@ class RedisDB : public DB {
 
   int Scan(const std::string &table, const std::string &key,
            int len, const std::vector<std::string> *fields,
-           std::vector<std::vector<KVPair>> &result) {
-    throw "Scan: function not implemented!";
-  }
+           std::vector<std::vector<KVPair>> &result);
 
   int Update(const std::string &table, const std::string &key,
              std::vector<KVPair> &values);
 
   int Insert(const std::string &table, const std::string &key,
-             std::vector<KVPair> &values) {
-    return Update(table, key, values);
-  }
+             std::vector<KVPair> &values);
+
+  int Delete(const std::string &table, const std::string &key);
 
-  int Delete(const std::string &table, const std::string &key) {
-    std::string cmd("DEL " + key);
-    redis_.Command(cmd);
-    return DB::kOK;
-  }
+  void PrintStats();
 
  private:
-  RedisClient redis_;
+  ///
+  /// The connection a command for a shard is sent on: the thread's own, or
+  /// one borrowed from the shard's pool until the command completes.
+  ///
+  class Connection {
+   public:
+    Connection(RedisDB &db, size_t shard);
+    ~Connection();
+    RedisClient *operator->() { return client_; }
+
+   private:
+    RedisClientPool *pool_;
+    RedisClient *client_;
+  };
+
+  struct Server {
+    std::string host;
+    int port;
+    std::string unixsocket; // used instead of host and port when set
+  };
+
+  RedisClient *NewClient(size_t shard);
+  size_t Route(const std::string &key);
+
+  // redis.servers lists the servers the keys are sharded over, routed by
+  // redis.sharding; otherwise there is a single one, at host and port
+  std::vector<Server> servers_;
+  RedisRouter router_;
+  int slaves_;
+
+  // With redis.pool_size set, threads share that many connections to each
+  // server instead of opening one each
+  std::vector<RedisClientPool *> pools_;
+
+  // With redis.pipeline set above 1, each thread queues that many writes
+  // per server before reading their replies; the latencies are merged in
+  // Close(), per server
+  size_t pipeline_depth_;
+  std::mutex stats_mutex_;
+  std::vector<utils::Histogram> command_latency_;
+  std::vector<utils::Histogram> batch_latency_;
+
+  // Operations per server, and the time spent choosing the server
+  std::vector<uint64_t> shard_ops_;
+  uint64_t routing_ns_;
+
+  // With redis.scan_index set, every key is also added to a sorted set per
+  // table on its server, which scans range over. The extra time its ZADDs
+  // and ZREMs cost is merged in Close()
+  bool scan_index_;
+  utils::Histogram index_add_latency_;
+  utils::Histogram index_remove_latency_;
 };
 
 } // ycsbc
@@ -9,14 +9,321 @@
 #include "db/rocks_db.h"
 #include <string>
 #include <vector>
+#include <memory>
+#include <chrono>
+#include <cerrno>
+#include <cstdlib>
 #include <rocksdb/convenience.h>
+#include <rocksdb/env.h>
+#include <rocksdb/iostats_context.h>
+#include <rocksdb/merge_operator.h>
+#include <rocksdb/perf_context.h>
+#include <rocksdb/perf_level.h>
+#include <rocksdb/sst_file_writer.h>
+#include <rocksdb/statistics.h>
+#include <rocksdb/table.h>
 #include <rocksdb/utilities/options_util.h>
+#include <rocksdb/utilities/write_batch_with_index.h>
+#include "core/measurements.h"
+#include "core/record_codec.h"
 
+using std::cerr;
 using std::string;
 using std::vector;
 
 namespace ycsbc {
 
+//
+// Statistics reported after every phase, under their RocksDB names
+//
+static const struct {
+  rocksdb::Tickers ticker;
+  const char *name;
+} statistics_tickers[] = {
+  { rocksdb::BLOCK_CACHE_HIT, "rocksdb.block.cache.hit" },
+  { rocksdb::BLOCK_CACHE_MISS, "rocksdb.block.cache.miss" },
+  { rocksdb::BLOOM_FILTER_USEFUL, "rocksdb.bloom.filter.useful" },
+  { rocksdb::BLOOM_FILTER_FULL_POSITIVE, "rocksdb.bloom.filter.full.positive" },
+  { rocksdb::BLOOM_FILTER_FULL_TRUE_POSITIVE, "rocksdb.bloom.filter.full.true.positive" },
+  { rocksdb::MEMTABLE_HIT, "rocksdb.memtable.hit" },
+  { rocksdb::MEMTABLE_MISS, "rocksdb.memtable.miss" },
+  { rocksdb::BYTES_WRITTEN, "rocksdb.bytes.written" },
+  { rocksdb::BYTES_READ, "rocksdb.bytes.read" },
+  { rocksdb::WAL_FILE_BYTES, "rocksdb.wal.bytes" },
+  { rocksdb::FLUSH_WRITE_BYTES, "rocksdb.flush.write.bytes" },
+  { rocksdb::COMPACT_READ_BYTES, "rocksdb.compact.read.bytes" },
+  { rocksdb::COMPACT_WRITE_BYTES, "rocksdb.compact.write.bytes" },
+  { rocksdb::STALL_MICROS, "rocksdb.stall.micros" },
+};
+
+static const struct {
+  rocksdb::Histograms histogram;
+  const char *name;
+} statistics_histograms[] = {
+  { rocksdb::DB_GET, "rocksdb.db.get.micros" },
+  { rocksdb::DB_MULTIGET, "rocksdb.db.multiget.micros" },
+  { rocksdb::DB_WRITE, "rocksdb.db.write.micros" },
+  { rocksdb::DB_SEEK, "rocksdb.db.seek.micros" },
+  { rocksdb::SST_READ_MICROS, "rocksdb.sst.read.micros" },
+  { rocksdb::WRITE_STALL, "rocksdb.db.write.stall" },
+  { rocksdb::FLUSH_TIME, "rocksdb.db.flush.micros" },
+  { rocksdb::COMPACTION_TIME, "rocksdb.compaction.times.micros" },
+};
+
+//
+// PerfContext and IOStatsContext counters summed over sampled operations
+//
+static const struct {
+  uint64_t rocksdb::PerfContext::*field;
+  const char *name;
+} perf_context_fields[] = {
+  { &rocksdb::PerfContext::user_key_comparison_count, "user_key_comparison_count" },
+  { &rocksdb::PerfContext::block_cache_hit_count, "block_cache_hit_count" },
+  { &rocksdb::PerfContext::block_read_count, "block_read_count" },
+  { &rocksdb::PerfContext::block_read_byte, "block_read_byte" },
+  { &rocksdb::PerfContext::block_read_time, "block_read_time" },
+  { &rocksdb::PerfContext::get_from_memtable_time, "get_from_memtable_time" },
+  { &rocksdb::PerfContext::get_from_output_files_time, "get_from_output_files_time" },
+  { &rocksdb::PerfContext::seek_internal_seek_time, "seek_internal_seek_time" },
+  { &rocksdb::PerfContext::find_next_user_entry_time, "find_next_user_entry_time" },
+  { &rocksdb::PerfContext::internal_key_skipped_count, "internal_key_skipped_count" },
+  { &rocksdb::PerfContext::internal_delete_skipped_count, "internal_delete_skipped_count" },
+  { &rocksdb::PerfContext::write_wal_time, "write_wal_time" },
+  { &rocksdb::PerfContext::write_memtable_time, "write_memtable_time" },
+  { &rocksdb::PerfContext::write_delay_time, "write_delay_time" },
+};
+
+static const struct {
+  uint64_t rocksdb::IOStatsContext::*field;
+  const char *name;
+} iostats_context_fields[] = {
+  { &rocksdb::IOStatsContext::bytes_read, "bytes_read" },
+  { &rocksdb::IOStatsContext::read_nanos, "read_nanos" },
+  { &rocksdb::IOStatsContext::bytes_written, "bytes_written" },
+  { &rocksdb::IOStatsContext::write_nanos, "write_nanos" },
+  { &rocksdb::IOStatsContext::fsync_nanos, "fsync_nanos" },
+};
+
+static const int kNumPerfContextFields = sizeof(perf_context_fields) / sizeof(perf_context_fields[0]);
+static const int kNumPerfFields = kNumPerfContextFields
+  + sizeof(iostats_context_fields) / sizeof(iostats_context_fields[0]);
+
+enum PerfOp { PERF_READ, PERF_MULTIREAD, PERF_SCAN, PERF_WRITE, PERF_MERGE, PERF_DELETE, PERF_TRANSACTION, NUM_PERF_OPS };
+static const char *perf_op_names[NUM_PERF_OPS] = { "READ", "MULTIREAD", "SCAN", "WRITE", "MERGE", "DELETE", "TRANSACTION" };
+
+struct RocksDBPerfStats {
+  uint64_t samples[NUM_PERF_OPS] = {};
+  uint64_t sums[NUM_PERF_OPS][kNumPerfFields] = {};
+
+  void Add(PerfOp op) {
+    const rocksdb::PerfContext *pc = rocksdb::get_perf_context();
+    const rocksdb::IOStatsContext *ioc = rocksdb::get_iostats_context();
+    samples[op]++;
+    for (int i = 0; i < kNumPerfContextFields; i++) {
+      sums[op][i] += pc->*perf_context_fields[i].field;
+    }
+    for (int i = kNumPerfContextFields; i < kNumPerfFields; i++) {
+      sums[op][i] += ioc->*iostats_context_fields[i - kNumPerfContextFields].field;
+    }
+  }
+
+  void Merge(const RocksDBPerfStats &other) {
+    for (int op = 0; op < NUM_PERF_OPS; op++) {
+      samples[op] += other.samples[op];
+      for (int i = 0; i < kNumPerfFields; i++) {
+        sums[op][i] += other.sums[op][i];
+      }
+    }
+  }
+
+  static const char *FieldName(int i) {
+    return i < kNumPerfContextFields ? perf_context_fields[i].name
+                                     : iostats_context_fields[i - kNumPerfContextFields].name;
+  }
+};
+
+//
+// State private to each client thread, set up by Init() and torn down by Close().
+//
+struct RocksDBThreadState {
+  std::string table;
+  rocksdb::ColumnFamilyHandle *column_family = NULL;
+
+  std::unique_ptr<rocksdb::SstFileWriter> sst_writer;
+  std::string sst_filename;
+  rocksdb::ColumnFamilyHandle *sst_column_family = NULL;
+
+  // Value found by the last Read(), pinned until the next one, and the part
+  // of it that was asked for
+  rocksdb::PinnableSlice read_value;
+  std::string_view last_value;
+  bool read_found = false;
+
+  // Encoded record being written
+  std::string record;
+
+  rocksdb::Iterator *scan_iterator = NULL;
+  rocksdb::ColumnFamilyHandle *scan_column_family = NULL;
+  uint64_t scans_since_refresh = 0;
+  std::string scan_upper_bound;
+
+  std::vector<rocksdb::Slice> multiget_keys;
+  std::vector<rocksdb::PinnableSlice> multiget_values;
+  std::vector<rocksdb::Status> multiget_statuses;
+  // Values of the last MultiRead, pinned until the next; NULL if not found
+  std::vector<std::string_view> multiget_found;
+
+  rocksdb::Transaction *txn = NULL;
+  utils::Histogram txn_commit_latency;
+
+  rocksdb::WriteBatchWithIndex batch; // indexed for Update() to read from
+  std::vector<uint64_t> batch_times; // when each batched write was issued
+  utils::Histogram commit_latency;
+  uint64_t batch_count = 0;
+  uint64_t user_bytes = 0; // keys and values written
+
+  RocksDBPerfStats perf_stats;
+  uint64_t ops_since_perf_sample = 0;
+};
+
+static thread_local RocksDBThreadState *thread_state = NULL;
+
+static inline uint64_t NowNanos()
+{
+  return std::chrono::duration_cast<std::chrono::nanoseconds>(
+      std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+//
+// Enables PerfContext and IOStatsContext for the lifetime of this object if
+// the current operation is one of the sampled ones.
+//
+class PerfSample {
+public:
+  PerfSample(uint64_t sample_rate, PerfOp op) : op(op), active(false) {
+    RocksDBThreadState *ts = thread_state;
+    if (sample_rate && ++ts->ops_since_perf_sample >= sample_rate) {
+      ts->ops_since_perf_sample = 0;
+      active = true;
+      rocksdb::SetPerfLevel(rocksdb::kEnableTimeExceptForMutex);
+      rocksdb::get_perf_context()->Reset();
+      rocksdb::get_iostats_context()->Reset();
+    }
+  }
+
+  ~PerfSample() {
+    if (active) {
+      thread_state->perf_stats.Add(op);
+      rocksdb::SetPerfLevel(rocksdb::kDisable);
+    }
+  }
+
+private:
+  PerfOp op;
+  bool active;
+};
+
+//
+// Operands are records holding some of the fields, which are set in the
+// existing record, so updating fields does not require reading it first.
+//
+class PatchMergeOperator : public rocksdb::AssociativeMergeOperator {
+public:
+  bool Merge(const rocksdb::Slice &key, const rocksdb::Slice *existing_value,
+             const rocksdb::Slice &value, string *new_value,
+             rocksdb::Logger *logger) const override {
+    if (existing_value) {
+      new_value->assign(existing_value->data(), existing_value->size());
+    } else {
+      new_value->clear();
+    }
+    RecordCodec::Patch(*new_value, std::string_view(value.data(), value.size()));
+    return true;
+  }
+
+  const char *Name() const override { return "YCSBPatchMergeOperator"; }
+};
+
+//
+// Keeps a 64-bit count in the kCounterField field of the record, which
+// each operand adds its own count to, so the record's other fields are
+// left as they are. A record without the field counts as 0.
+//
+class CounterMergeOperator : public rocksdb::AssociativeMergeOperator {
+public:
+  static constexpr const char *kCounterField = "merge_counter";
+
+  bool Merge(const rocksdb::Slice &key, const rocksdb::Slice *existing_value,
+             const rocksdb::Slice &value, string *new_value,
+             rocksdb::Logger *logger) const override {
+    uint64_t sum = Count(value);
+    if (existing_value) {
+      sum += Count(*existing_value);
+      new_value->assign(existing_value->data(), existing_value->size());
+    } else {
+      new_value->clear();
+    }
+    RecordCodec::Patch(*new_value, Operand(sum));
+    return true;
+  }
+
+  const char *Name() const override { return "YCSBCounterMergeOperator"; }
+
+  ///
+  /// The fields of an operand adding count
+  ///
+  static const vector<DB::KVPair> &Operand(uint64_t count) {
+    static thread_local vector<DB::KVPair> fields(1);
+    fields[0].first = kCounterField;
+    fields[0].second.assign((const char *)&count, sizeof(count));
+    return fields;
+  }
+
+private:
+  static uint64_t Count(const rocksdb::Slice &s) {
+    std::string_view record(s.data(), s.size());
+    uint64_t n = 0;
+    size_t i;
+    RecordCodec::FieldView field;
+    if (RecordCodec::Find(record, kCounterField, i) &&
+        RecordCodec::Field(record, i, field) && field.second.size() == sizeof(n)) {
+      memcpy(&n, field.second.data(), sizeof(n));
+    }
+    return n;
+  }
+};
+
+//
+// Sets the ReadOptions field called name; returns false if there is none.
+//
+static bool SetReadOption(rocksdb::ReadOptions &ropts, const string &name, const string &value)
+{
+  if (name == "verify_checksums") {
+    ropts.verify_checksums = utils::StrToBool(value);
+  } else if (name == "fill_cache") {
+    ropts.fill_cache = utils::StrToBool(value);
+  } else if (name == "async_io") {
+    ropts.async_io = utils::StrToBool(value);
+  } else if (name == "optimize_multiget_for_io") {
+    ropts.optimize_multiget_for_io = utils::StrToBool(value);
+  } else if (name == "readahead_size") {
+    ropts.readahead_size = std::stoull(value);
+  } else if (name == "adaptive_readahead") {
+    ropts.adaptive_readahead = utils::StrToBool(value);
+  } else if (name == "total_order_seek") {
+    ropts.total_order_seek = utils::StrToBool(value);
+  } else if (name == "auto_prefix_mode") {
+    ropts.auto_prefix_mode = utils::StrToBool(value);
+  } else if (name == "prefix_same_as_start") {
+    ropts.prefix_same_as_start = utils::StrToBool(value);
+  } else if (name == "pin_data") {
+    ropts.pin_data = utils::StrToBool(value);
+  } else {
+    return false;
+  }
+  return true;
+}
+
 void RocksDB::InitializeOptions(utils::Properties &props)
 {
   const std::map<std::string, std::string> &m = (const std::map<std::string, std::string> &)props;
@@ -24,15 +331,52 @@ void RocksDB::InitializeOptions(utils::Properties &props)
 
   if (m.count("rocksdb.config_file")) {
     std::vector<rocksdb::ColumnFamilyDescriptor> cf_descs;
-    assert(LoadOptionsFromFile(copts, m.at("rocksdb.config_file"), &options, &cf_descs) == rocksdb::Status::OK());
+    rocksdb::DBOptions db_options;
+    assert(LoadOptionsFromFile(copts, m.at("rocksdb.config_file"), &db_options, &cf_descs) == rocksdb::Status::OK());
+    rocksdb::ColumnFamilyOptions cf_options;
+    for (auto &desc : cf_descs) {
+      if (desc.name == rocksdb::kDefaultColumnFamilyName) {
+        cf_options = desc.options;
+      }
+    }
+    options = rocksdb::Options(db_options, cf_options);
   }
 
   std::unordered_map<std::string, std::string> options_map;
+  std::unordered_map<std::string, std::string> cf_options_map;
+  std::unordered_map<std::string, std::string> table_options_map;
+  std::string merge_operator = "none";
   for (auto tuple : m) {
     if (tuple.first.find("rocksdb.options.") == 0) {
       auto key = tuple.first.substr(strlen("rocksdb.options."), std::string::npos);
       options_map[key] = tuple.second;
+    } else if (tuple.first.find("rocksdb.cf_options.") == 0) {
+      auto key = tuple.first.substr(strlen("rocksdb.cf_options."), std::string::npos);
+      cf_options_map[key] = tuple.second;
+    } else if (tuple.first.find("rocksdb.table_options.") == 0) {
+      auto key = tuple.first.substr(strlen("rocksdb.table_options."), std::string::npos);
+      table_options_map[key] = tuple.second;
 
+    } else if (tuple.first.find("rocksdb.read_options.") == 0) {
+      auto key = tuple.first.substr(strlen("rocksdb.read_options."), std::string::npos);
+      if (!SetReadOption(roptions, key, tuple.second)) {
+        std::cout << "Unknown rocksdb config option " << tuple.first << std::endl;
+        assert(0);
+      }
+    } else if (tuple.first.find("rocksdb.multiget_options.") == 0) {
+      auto key = tuple.first.substr(strlen("rocksdb.multiget_options."), std::string::npos);
+      if (!SetReadOption(mgoptions, key, tuple.second)) {
+        std::cout << "Unknown rocksdb config option " << tuple.first << std::endl;
+        assert(0);
+      }
+    } else if (tuple.first.find("rocksdb.scan_options.") == 0) {
+      auto key = tuple.first.substr(strlen("rocksdb.scan_options."), std::string::npos);
+      if (!SetReadOption(soptions, key, tuple.second)) {
+        std::cout << "Unknown rocksdb config option " << tuple.first << std::endl;
+        assert(0);
+      }
+    } else if (tuple.first == "rocksdb.merge_operator") {
+      merge_operator = tuple.second;
     } else if (tuple.first == "rocksdb.write_options.sync") {
       long int sync = props.GetIntProperty("rocksdb.write_options.sync");
       woptions.sync = sync;
@@ -41,39 +385,194 @@ void RocksDB::InitializeOptions(utils::Properties &props)
       woptions.disableWAL = disableWAL;
     } else if (tuple.first == "rocksdb.config_file") {
       // ignore it here -- loaded above
-    } else if (tuple.first == "rocksdb.database_filename") {
+    } else if (tuple.first == "rocksdb.database_filename"
+               || tuple.first == "rocksdb.bulk_load.dir"
+               || tuple.first == "rocksdb.bulk_load.file_size_mb"
+               || tuple.first == "rocksdb.batch_size"
+               || tuple.first == "rocksdb.batch_us"
+               || tuple.first == "rocksdb.scan_refresh_interval"
+               || tuple.first == "rocksdb.scan_upper_bound_stride"
+               || tuple.first == "rocksdb.column_family_per_table"
+               || tuple.first == "rocksdb.statistics"
+               || tuple.first == "rocksdb.perf_sample_rate"
+               || tuple.first == "rocksdb.transactions"
+               || tuple.first == "rocksdb.transaction_lock_timeout_ms") {
       // ignore it, used in constructor
     } else if (tuple.first.find("rocksdb.") == 0) {
       std::cout << "Unknown rocksdb config option " << tuple.first << std::endl;
       assert(0);
     }
   }
-  rocksdb::Options new_options;
-  assert(GetDBOptionsFromMap(copts, options, options_map, &new_options) == rocksdb::Status::OK());
-  options = new_options;
+  rocksdb::DBOptions db_options;
+  assert(GetDBOptionsFromMap(copts, options, options_map, &db_options) == rocksdb::Status::OK());
+  rocksdb::ColumnFamilyOptions cf_options;
+  assert(GetColumnFamilyOptionsFromMap(copts, options, cf_options_map, &cf_options) == rocksdb::Status::OK());
+
+  // Table options are applied on top of those of the current table factory,
+  // e.g. from the config file, if it is a block-based one
+  if (!table_options_map.empty()) {
+    rocksdb::BlockBasedTableOptions table_options;
+    const rocksdb::BlockBasedTableOptions *base_table_options =
+      cf_options.table_factory->GetOptions<rocksdb::BlockBasedTableOptions>();
+    if (base_table_options) {
+      table_options = *base_table_options;
+    }
+    rocksdb::BlockBasedTableOptions new_table_options;
+    assert(GetBlockBasedTableOptionsFromMap(copts, table_options, table_options_map, &new_table_options) == rocksdb::Status::OK());
+    cf_options.table_factory.reset(rocksdb::NewBlockBasedTableFactory(new_table_options));
+  }
+
+  if (merge_operator == "patch") {
+    cf_options.merge_operator.reset(new PatchMergeOperator());
+  } else if (merge_operator == "counter") {
+    cf_options.merge_operator.reset(new CounterMergeOperator());
+  } else if (merge_operator != "none") {
+    std::cout << "Unknown rocksdb.merge_operator " << merge_operator << std::endl;
+    assert(0);
+  }
+  counter_merge = merge_operator == "counter";
+
+  options = rocksdb::Options(db_options, cf_options);
 }
 
-  RocksDB::RocksDB(utils::Properties &props, bool preloaded)
+RocksDB::RocksDB(utils::Properties &props, bool preloaded)
+  : txn_db(NULL), optimistic_txn_db(NULL), batch_count(0), user_bytes(0), total_user_bytes(0), total_flush_compaction_bytes(0),
+    perf_stats(new RocksDBPerfStats()), bulk_load_file_count(0)
 {
   InitializeOptions(props);
+
+  // Statistics cost every operation something, so they are only collected
+  // when asked for; tickers are then needed for write amplification
+  std::string statistics = props.GetProperty("rocksdb.statistics");
+  if (statistics != "none") {
+    if (!options.statistics) {
+      options.statistics = rocksdb::CreateDBStatistics();
+    }
+    if (statistics == "tickers") {
+      options.statistics->set_stats_level(rocksdb::kExceptHistogramOrTimers);
+    } else if (statistics == "histograms") {
+      options.statistics->set_stats_level(rocksdb::kExceptDetailedTimers);
+    } else if (statistics == "all") {
+      options.statistics->set_stats_level(rocksdb::kAll);
+    } else {
+      std::cout << "Unknown rocksdb.statistics level " << statistics << std::endl;
+      assert(0);
+    }
+  }
+  perf_sample_rate = props.GetIntProperty("rocksdb.perf_sample_rate");
+
+  batch_size = props.GetIntProperty("rocksdb.batch_size");
+  batch_ns = props.GetIntProperty("rocksdb.batch_us") * 1000;
+  scan_refresh_interval = props.GetIntProperty("rocksdb.scan_refresh_interval");
+  scan_upper_bound_stride = props.GetIntProperty("rocksdb.scan_upper_bound_stride");
   std::string database_filename = props.GetProperty("rocksdb.database_filename");
+  bulk_load_dir = props.GetProperty("rocksdb.bulk_load.dir", database_filename + ".bulk");
+  bulk_load_file_size = props.GetIntProperty("rocksdb.bulk_load.file_size_mb") * 1024 * 1024;
+  column_family_per_table = props.GetIntProperty("rocksdb.column_family_per_table");
+  field_count = props.GetIntProperty(CoreWorkload::FIELD_COUNT_PROPERTY);
   options.create_if_missing = !preloaded;
   options.error_if_exists = !preloaded;
-  rocksdb::Status status = rocksdb::DB::Open(options, database_filename, &db);
+
+  // Every column family must be opened, so a preloaded database may bring
+  // the column families of its tables along
+  std::vector<std::string> cf_names;
+  rocksdb::Status status;
+  if (preloaded) {
+    status = rocksdb::DB::ListColumnFamilies(options, database_filename, &cf_names);
+    assert(status.ok());
+  } else {
+    cf_names.push_back(rocksdb::kDefaultColumnFamilyName);
+  }
+  std::vector<rocksdb::ColumnFamilyDescriptor> cf_descs;
+  for (const string &name : cf_names) {
+    cf_descs.push_back(rocksdb::ColumnFamilyDescriptor(name, options));
+  }
+  std::vector<rocksdb::ColumnFamilyHandle *> handles;
+  std::string transactions = props.GetProperty("rocksdb.transactions");
+  if (transactions == "pessimistic") {
+    rocksdb::TransactionDBOptions txn_db_options;
+    txn_db_options.transaction_lock_timeout = props.GetIntProperty("rocksdb.transaction_lock_timeout_ms");
+    txn_options.deadlock_detect = true;
+    status = rocksdb::TransactionDB::Open(options, txn_db_options, database_filename,
+                                          cf_descs, &handles, &txn_db);
+    db = txn_db;
+  } else if (transactions == "optimistic") {
+    status = rocksdb::OptimisticTransactionDB::Open(options, database_filename,
+                                                    cf_descs, &handles, &optimistic_txn_db);
+    db = optimistic_txn_db;
+  } else if (transactions == "none") {
+    status = rocksdb::DB::Open(options, database_filename, cf_descs, &handles, &db);
+  } else {
+    std::cout << "Unknown rocksdb.transactions mode " << transactions << std::endl;
+    assert(0);
+  }
   assert(status.ok());
+  for (size_t i = 0; i < handles.size(); i++) {
+    column_families[cf_names[i]] = handles[i];
+  }
 }
 
 RocksDB::~RocksDB()
 {
+  for (auto &cf : column_families) {
+    db->DestroyColumnFamilyHandle(cf.second);
+  }
   delete db;
 }
 
+//
+// Returns the column family holding table, creating it if needed.
+// The last one used is cached per thread, so the lock is rarely taken.
+//
+rocksdb::ColumnFamilyHandle *RocksDB::ColumnFamily(const string &table)
+{
+  if (!column_family_per_table) {
+    return db->DefaultColumnFamily();
+  }
+  RocksDBThreadState *ts = thread_state;
+  if (ts->column_family && ts->table == table) {
+    return ts->column_family;
+  }
+  std::lock_guard<std::mutex> lock(column_families_mutex);
+  rocksdb::ColumnFamilyHandle *&handle = column_families[table];
+  if (!handle) {
+    rocksdb::Status status = db->CreateColumnFamily(options, table, &handle);
+    assert(status.ok());
+  }
+  ts->table = table;
+  ts->column_family = handle;
+  return handle;
+}
+
 void RocksDB::Init()
 {
+  thread_state = new RocksDBThreadState();
 }
 
 void RocksDB::Close()
 {
+  if (thread_state->sst_writer) {
+    FinishBulkLoadFile();
+  }
+  if (!thread_state->batch_times.empty()) {
+    CommitBatch();
+  }
+  thread_state->read_value.Reset();
+  for (size_t i = 0; i < thread_state->multiget_found.size(); i++) {
+    thread_state->multiget_values[i].Reset();
+  }
+  delete thread_state->scan_iterator;
+  delete thread_state->txn;
+  {
+    std::lock_guard<std::mutex> lock(stats_mutex);
+    commit_latency.Merge(thread_state->commit_latency);
+    txn_commit_latency.Merge(thread_state->txn_commit_latency);
+    batch_count += thread_state->batch_count;
+    user_bytes += thread_state->user_bytes;
+    perf_stats->Merge(thread_state->perf_stats);
+  }
+  delete thread_state;
+  thread_state = NULL;
 }
 
 int RocksDB::Read(const string &table,
@@ -81,48 +580,529 @@ int RocksDB::Read(const string &table,
                      const vector<string> *fields,
                      vector<KVPair> &result)
 {
-  string value;
-  rocksdb::Status status = db->Get(roptions, rocksdb::Slice(key), &value);
+  CommitBatchIfDue();
+  PerfSample sample(perf_sample_rate, PERF_READ);
+  // Pinning avoids copying the value out of the block cache or memtable
+  rocksdb::PinnableSlice *value = &thread_state->read_value;
+  value->Reset();
+  rocksdb::Status status = db->Get(roptions, ColumnFamily(table), rocksdb::Slice(key), value);
   assert(status.ok() || status.IsNotFound()); // TODO is it expected we're querying non-existing keys?
+  thread_state->read_found = status.ok();
+  if (thread_state->read_found) {
+    // A single requested field is handed back on its own
+    std::string_view record(value->data(), value->size());
+    size_t index;
+    if (fields && fields->size() == 1) {
+      RecordCodec::FieldView field;
+      thread_state->read_found = RecordCodec::Find(record, (*fields)[0], index) &&
+          RecordCodec::Field(record, index, field);
+      if (thread_state->read_found) {
+        record = field.second;
+      }
+    }
+    thread_state->last_value = record;
+  }
+  return DB::kOK;
+}
+
+bool RocksDB::LastValue(std::string_view &value)
+{
+  if (!thread_state->read_found) {
+    return false;
+  }
+  value = thread_state->last_value;
+  return true;
+}
+
+int RocksDB::MultiRead(const string &table,
+                       const vector<string> &keys,
+                       const vector<string> *fields,
+                       vector<vector<KVPair>> &result)
+{
+  CommitBatchIfDue();
+  PerfSample sample(perf_sample_rate, PERF_MULTIREAD);
+  size_t n = keys.size();
+  RocksDBThreadState *ts = thread_state;
+  for (size_t i = 0; i < ts->multiget_found.size(); i++) {
+    ts->multiget_values[i].Reset();
+  }
+  ts->multiget_keys.clear();
+  for (const string &key : keys) {
+    ts->multiget_keys.push_back(rocksdb::Slice(key));
+  }
+  if (ts->multiget_values.size() < n) {
+    ts->multiget_values.resize(n);
+    ts->multiget_statuses.resize(n);
+  }
+  db->MultiGet(mgoptions, ColumnFamily(table), n, ts->multiget_keys.data(),
+               ts->multiget_values.data(), ts->multiget_statuses.data());
+  ts->multiget_found.assign(n, std::string_view());
+  for (size_t i = 0; i < n; i++) {
+    assert(ts->multiget_statuses[i].ok() || ts->multiget_statuses[i].IsNotFound());
+    if (!ts->multiget_statuses[i].ok()) {
+      continue;
+    }
+    // A single requested field is handed back on its own, as by Read()
+    std::string_view record(ts->multiget_values[i].data(), ts->multiget_values[i].size());
+    size_t index;
+    RecordCodec::FieldView field;
+    if (fields && fields->size() == 1) {
+      if (!RecordCodec::Find(record, (*fields)[0], index) ||
+          !RecordCodec::Field(record, index, field)) {
+        continue;
+      }
+      record = field.second;
+    }
+    ts->multiget_found[i] = record;
+  }
   return DB::kOK;
 }
 
+bool RocksDB::LastMultiReadValue(size_t index, std::string_view &value)
+{
+  if (index >= thread_state->multiget_found.size()
+      || !thread_state->multiget_found[index].data()) {
+    return false;
+  }
+  value = thread_state->multiget_found[index];
+  return true;
+}
+
 int RocksDB::Scan(const string &table,
                   const string &key, int len,
                   const vector<string> *fields,
                   vector<vector<KVPair>> &result)
 {
-  rocksdb::Iterator* it = db->NewIterator(roptions);
+  CommitBatchIfDue();
+  PerfSample sample(perf_sample_rate, PERF_SCAN);
+  RocksDBThreadState *ts = thread_state;
+  rocksdb::ColumnFamilyHandle *cf = ColumnFamily(table);
+  rocksdb::Iterator *it;
+  if (scan_upper_bound_stride) {
+    rocksdb::ReadOptions bounded_options = soptions;
+    rocksdb::Slice upper_bound;
+    if (ScanUpperBound(key, len, ts->scan_upper_bound)) {
+      upper_bound = rocksdb::Slice(ts->scan_upper_bound);
+      bounded_options.iterate_upper_bound = &upper_bound;
+    }
+    it = db->NewIterator(bounded_options, cf);
+  } else if (scan_refresh_interval == 0) {
+    it = db->NewIterator(soptions, cf);
+  } else {
+    if (!ts->scan_iterator || ts->scan_column_family != cf) {
+      delete ts->scan_iterator;
+      ts->scan_iterator = db->NewIterator(soptions, cf);
+      ts->scan_column_family = cf;
+      ts->scans_since_refresh = 0;
+    } else if (++ts->scans_since_refresh >= scan_refresh_interval) {
+      rocksdb::Status status = ts->scan_iterator->Refresh();
+      assert(status.ok());
+      ts->scans_since_refresh = 0;
+    }
+    it = ts->scan_iterator;
+  }
+
   int i = 0;
   for (it->Seek(key); i < len && it->Valid(); it->Next()) {
     i++;
   }
-  delete it;
+  if (it != ts->scan_iterator) {
+    delete it;
+  }
   return DB::kOK;
 }
 
+//
+// Keys end in a fixed-width decimal record number, so the first key past a
+// scan of len records spaced stride apart is found by adding to that number.
+// Returns false if the key has no such number or the sum overflows.
+//
+bool RocksDB::ScanUpperBound(const string &key, int len, string &bound)
+{
+  size_t digits_start = key.find_last_not_of("0123456789") + 1;
+  size_t width = key.size() - digits_start;
+  if (width == 0 || width > 20) {
+    return false;
+  }
+  errno = 0;
+  uint64_t key_num = strtoull(key.c_str() + digits_start, NULL, 10);
+  uint64_t distance = len * scan_upper_bound_stride;
+  if (errno || distance / scan_upper_bound_stride != (uint64_t)len
+      || key_num + distance < key_num) {
+    return false;
+  }
+  string number = std::to_string(key_num + distance);
+  if (number.size() > width) {
+    return false;
+  }
+  bound.assign(key, 0, digits_start).append(width - number.size(), '0').append(number);
+  return true;
+}
+
+//
+// Updates of some of the fields read the record, patch it and write it back.
+// The read sees the thread's own writes still in its batch.
+//
 int RocksDB::Update(const string &table,
                     const string &key,
                     vector<KVPair> &values)
 {
-  return Insert(table, key, values);
+  if (values.size() >= field_count) {
+    return Insert(table, key, values);
+  }
+  PerfSample sample(perf_sample_rate, PERF_WRITE);
+  rocksdb::ColumnFamilyHandle *cf = ColumnFamily(table);
+  std::string &record = thread_state->record;
+  rocksdb::Status status;
+  if (batch_size > 1) {
+    status = thread_state->batch.GetFromBatchAndDB(db, roptions, cf, rocksdb::Slice(key), &record);
+  } else {
+    status = db->Get(roptions, cf, rocksdb::Slice(key), &record);
+  }
+  assert(status.ok() || status.IsNotFound());
+  if (status.ok()) {
+    RecordCodec::Patch(record, values);
+  } else {
+    RecordCodec::Encode(values, record);
+  }
+  WriteRecord(cf, key, record);
+  return DB::kOK;
 }
 
-int RocksDB::Insert(const string &table, const string &key, vector<KVPair> &values)
+//
+// Without a merge operator this falls back to reading the record and then
+// writing it, like a read-modify-write.
+//
+int RocksDB::Merge(const string &table, const string &key, vector<KVPair> &values)
 {
-  assert(values.size() == 1);
-  rocksdb::Status status = db->Put(woptions, rocksdb::Slice(key), rocksdb::Slice(values[0].second));
+  if (!options.merge_operator) {
+    return DB::Merge(table, key, values);
+  }
+  PerfSample sample(perf_sample_rate, PERF_MERGE);
+  rocksdb::ColumnFamilyHandle *cf = ColumnFamily(table);
+  RecordCodec::Encode(counter_merge ? CounterMergeOperator::Operand(1) : values,
+                      thread_state->record);
+  rocksdb::Slice operand(thread_state->record);
+  thread_state->user_bytes += key.size() + operand.size();
+  if (batch_size > 1) {
+    thread_state->batch.Merge(cf, rocksdb::Slice(key), operand);
+    AddedToBatch();
+    return DB::kOK;
+  }
+  rocksdb::Status status = db->Merge(woptions, cf, rocksdb::Slice(key), operand);
   assert(status.ok());
   return DB::kOK;
 }
 
+int RocksDB::Insert(const string &table, const string &key, vector<KVPair> &values)
+{
+  PerfSample sample(perf_sample_rate, PERF_WRITE);
+  RecordCodec::Encode(values, thread_state->record);
+  WriteRecord(ColumnFamily(table), key, thread_state->record);
+  return DB::kOK;
+}
+
+void RocksDB::WriteRecord(rocksdb::ColumnFamilyHandle *cf, const string &key,
+                          const string &record)
+{
+  thread_state->user_bytes += key.size() + record.size();
+  if (batch_size > 1) {
+    thread_state->batch.Put(cf, rocksdb::Slice(key), rocksdb::Slice(record));
+    AddedToBatch();
+    return;
+  }
+  rocksdb::Status status = db->Put(woptions, cf, rocksdb::Slice(key), rocksdb::Slice(record));
+  assert(status.ok());
+}
+
 int RocksDB::Delete(const string &table, const string &key)
 {
-  rocksdb::Status status = db->Delete(woptions, rocksdb::Slice(key));
+  PerfSample sample(perf_sample_rate, PERF_DELETE);
+  thread_state->user_bytes += key.size();
+  rocksdb::ColumnFamilyHandle *cf = ColumnFamily(table);
+  if (batch_size > 1) {
+    thread_state->batch.Delete(cf, rocksdb::Slice(key));
+    AddedToBatch();
+    return DB::kOK;
+  }
+  rocksdb::Status status = db->Delete(woptions, cf, rocksdb::Slice(key));
+  assert(status.ok());
+  return DB::kOK;
+}
+
+static inline bool IsConflict(const rocksdb::Status &status)
+{
+  return status.IsBusy() || status.IsTimedOut() || status.IsTryAgain() || status.IsDeadlock();
+}
+
+//
+// Pessimistic transactions lock each record as it is read and fail when a
+// lock cannot be had; optimistic ones fail at commit if a record they read
+// has changed since. Each thread reuses its Transaction object.
+//
+int RocksDB::ExecuteTransaction(const string &table,
+                                const vector<string> &keys,
+                                const vector<string> *fields,
+                                vector<KVPair> &values)
+{
+  if (!txn_db && !optimistic_txn_db) {
+    return DB::ExecuteTransaction(table, keys, fields, values);
+  }
+  CommitBatchIfDue();
+  PerfSample sample(perf_sample_rate, PERF_TRANSACTION);
+  RocksDBThreadState *ts = thread_state;
+  rocksdb::ColumnFamilyHandle *cf = ColumnFamily(table);
+  if (txn_db) {
+    ts->txn = txn_db->BeginTransaction(woptions, txn_options, ts->txn);
+  } else {
+    ts->txn = optimistic_txn_db->BeginTransaction(woptions, optimistic_txn_options, ts->txn);
+  }
+
+  rocksdb::Status status;
+  uint64_t txn_bytes = 0;
+  for (const string &key : keys) {
+    status = ts->txn->GetForUpdate(roptions, cf, rocksdb::Slice(key), &ts->record);
+    if (status.ok() && values.size() < field_count) {
+      RecordCodec::Patch(ts->record, values);
+    } else if (status.ok() || status.IsNotFound()) {
+      RecordCodec::Encode(values, ts->record);
+    } else {
+      break;
+    }
+    txn_bytes += key.size() + ts->record.size();
+    status = ts->txn->Put(cf, rocksdb::Slice(key), rocksdb::Slice(ts->record));
+    if (!status.ok()) {
+      break;
+    }
+  }
+  if (!status.ok()) {
+    assert(IsConflict(status));
+    ts->txn->Rollback();
+    return DB::kErrorConflict;
+  }
+
+  uint64_t start = NowNanos();
+  status = ts->txn->Commit();
+  ts->txn_commit_latency.Add(NowNanos() - start);
+  if (!status.ok()) {
+    assert(IsConflict(status));
+    return DB::kErrorConflict;
+  }
+  ts->user_bytes += txn_bytes;
+  return DB::kOK;
+}
+
+void RocksDB::AddedToBatch()
+{
+  thread_state->batch_times.push_back(NowNanos());
+  if (thread_state->batch_times.size() >= batch_size) {
+    CommitBatch();
+    return;
+  }
+  CommitBatchIfDue();
+}
+
+//
+// Called by every operation, so a batch is committed on time even when the
+// thread has stopped writing.
+//
+void RocksDB::CommitBatchIfDue()
+{
+  if (batch_ns && !thread_state->batch_times.empty()
+      && NowNanos() - thread_state->batch_times[0] >= batch_ns) {
+    CommitBatch();
+  }
+}
+
+//
+// Writes are not visible to reads, even by the thread that issued them,
+// until their batch commits; only Update() reads through the batch. Each
+// write's latency is the time until its batch committed.
+//
+void RocksDB::CommitBatch()
+{
+  rocksdb::Status status = db->Write(woptions, thread_state->batch.GetWriteBatch());
+  assert(status.ok());
+  uint64_t now = NowNanos();
+  for (uint64_t issued : thread_state->batch_times) {
+    thread_state->commit_latency.Add(now - issued);
+  }
+  thread_state->batch_count++;
+  thread_state->batch.Clear();
+  thread_state->batch_times.clear();
+}
+
+void RocksDB::StartBulkLoadFile(rocksdb::ColumnFamilyHandle *cf)
+{
+  rocksdb::Status status = options.env->CreateDirIfMissing(bulk_load_dir);
+  assert(status.ok());
+  thread_state->sst_filename = bulk_load_dir + "/" + std::to_string(bulk_load_file_count++) + ".sst";
+  thread_state->sst_writer.reset(new rocksdb::SstFileWriter(rocksdb::EnvOptions(), options, cf));
+  thread_state->sst_column_family = cf;
+  status = thread_state->sst_writer->Open(thread_state->sst_filename);
+  assert(status.ok());
+}
+
+void RocksDB::FinishBulkLoadFile()
+{
+  rocksdb::Status status = thread_state->sst_writer->Finish();
+  assert(status.ok());
+  thread_state->sst_writer.reset();
+  std::lock_guard<std::mutex> lock(bulk_load_mutex);
+  bulk_load_files[thread_state->sst_column_family].push_back(thread_state->sst_filename);
+}
+
+int RocksDB::BulkInsert(const string &table, const string &key, vector<KVPair> &values)
+{
+  rocksdb::ColumnFamilyHandle *cf = ColumnFamily(table);
+  if (thread_state->sst_writer
+      && (thread_state->sst_writer->FileSize() >= bulk_load_file_size
+          || thread_state->sst_column_family != cf)) {
+    FinishBulkLoadFile();
+  }
+  if (!thread_state->sst_writer) {
+    StartBulkLoadFile(cf);
+  }
+  RecordCodec::Encode(values, thread_state->record);
+  thread_state->user_bytes += key.size() + thread_state->record.size();
+  rocksdb::Status status = thread_state->sst_writer->Put(rocksdb::Slice(key), rocksdb::Slice(thread_state->record));
   assert(status.ok());
   return DB::kOK;
 }
 
+void RocksDB::PrintStats()
+{
+  std::lock_guard<std::mutex> lock(stats_mutex);
+  PrintStatistics();
+  PrintWriteAmplification();
+  PrintPerfStats();
+  if (batch_count) {
+    cerr << "# RocksDB write batches:\t" << batch_count << endl;
+    cerr << "# RocksDB records per write batch:\t"
+         << (double)commit_latency.Count() / batch_count << endl;
+    Measurements::PrintHeader(cerr, "RocksDB time to commit");
+    Measurements::PrintHistogram(cerr, "WRITE", commit_latency);
+  }
+  if (txn_commit_latency.Count()) {
+    Measurements::PrintHeader(cerr, "RocksDB transaction commit");
+    Measurements::PrintHistogram(cerr, "COMMIT", txn_commit_latency);
+  }
+  commit_latency.Clear();
+  txn_commit_latency.Clear();
+  batch_count = 0;
+}
+
+void RocksDB::PrintStatistics()
+{
+  rocksdb::Statistics *statistics = options.statistics.get();
+  if (!statistics) {
+    return;
+  }
+  for (auto &t : statistics_tickers) {
+    cerr << "# " << t.name << ":\t" << statistics->getTickerCount(t.ticker) << endl;
+  }
+
+  if (statistics->get_stats_level() > rocksdb::kExceptHistogramOrTimers) {
+    cerr << "# RocksDB histograms (us)" << endl;
+    cerr << "#\thistogram\tcount\tavg\tp50\tp99\tmax" << endl;
+    for (auto &h : statistics_histograms) {
+      rocksdb::HistogramData data;
+      statistics->histogramData(h.histogram, &data);
+      if (data.count) {
+        cerr << "#\t" << h.name << '\t' << data.count << '\t' << data.average
+             << '\t' << data.median << '\t' << data.percentile99
+             << '\t' << data.max << endl;
+      }
+    }
+  }
+  statistics->Reset();
+}
+
+//
+// Write amplification counts the bytes flushed and compacted to SST files
+// per byte of keys and values written by the clients. The former come from
+// the compaction stats of each column family (where flushes count as
+// writes to L0), so no Statistics are needed.
+//
+void RocksDB::PrintWriteAmplification()
+{
+  uint64_t flush_compaction_bytes = FlushCompactionBytes();
+  uint64_t phase_bytes = flush_compaction_bytes > total_flush_compaction_bytes ?
+      flush_compaction_bytes - total_flush_compaction_bytes : 0;
+  total_flush_compaction_bytes = flush_compaction_bytes;
+  total_user_bytes += user_bytes;
+  if (user_bytes) {
+    cerr << "# RocksDB write amplification:\t"
+         << (double)phase_bytes / user_bytes << endl;
+  }
+  if (total_user_bytes) {
+    cerr << "# RocksDB cumulative write amplification:\t"
+         << (double)total_flush_compaction_bytes / total_user_bytes << endl;
+  }
+  user_bytes = 0;
+}
+
+//
+// Bytes written to SST files by flushes and compactions since the database
+// was opened, summed over the column families.
+//
+uint64_t RocksDB::FlushCompactionBytes()
+{
+  std::lock_guard<std::mutex> lock(column_families_mutex);
+  double gb = 0;
+  for (auto &cf : column_families) {
+    std::map<std::string, std::string> cf_stats;
+    if (db->GetMapProperty(cf.second, rocksdb::DB::Properties::kCFStats, &cf_stats)) {
+      auto write_gb = cf_stats.find("compaction.Sum.WriteGB");
+      if (write_gb != cf_stats.end()) {
+        gb += strtod(write_gb->second.c_str(), NULL);
+      }
+    }
+  }
+  return gb * (1ULL << 30);
+}
+
+void RocksDB::PrintPerfStats()
+{
+  bool header = false;
+  for (int op = 0; op < NUM_PERF_OPS; op++) {
+    uint64_t samples = perf_stats->samples[op];
+    if (!samples) {
+      continue;
+    }
+    if (!header) {
+      cerr << "# RocksDB perf context, average per sampled op" << endl;
+      header = true;
+    }
+    cerr << "#\t" << perf_op_names[op] << "\tsamples\t" << samples << endl;
+    for (int i = 0; i < kNumPerfFields; i++) {
+      if (perf_stats->sums[op][i]) {
+        cerr << "#\t" << perf_op_names[op] << '\t' << RocksDBPerfStats::FieldName(i)
+             << '\t' << (double)perf_stats->sums[op][i] / samples << endl;
+      }
+    }
+  }
+  *perf_stats = RocksDBPerfStats();
+}
+
+void RocksDB::FinishBulkLoad()
+{
+  std::lock_guard<std::mutex> lock(bulk_load_mutex);
+  if (bulk_load_files.empty()) {
+    return;
+  }
+  // The files of different threads cover disjoint key ranges, so they can
+  // all be ingested at once, and moving them avoids a copy.
+  rocksdb::IngestExternalFileOptions ifo;
+  ifo.move_files = true;
+  for (auto &cf_files : bulk_load_files) {
+    rocksdb::Status status = db->IngestExternalFile(cf_files.first, cf_files.second, ifo);
+    assert(status.ok());
+  }
+  bulk_load_files.clear();
+  options.env->DeleteDir(bulk_load_dir);
+}
+
 } // ycsbc
 
 
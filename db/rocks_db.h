@@ -10,14 +10,23 @@
 
 #include <iostream>
 #include <string>
+#include <map>
+#include <mutex>
+#include <atomic>
+#include <memory>
 #include "core/properties.h"
+#include "core/histogram.h"
 #include "rocksdb/db.h"
+#include "rocksdb/utilities/optimistic_transaction_db.h"
+#include "rocksdb/utilities/transaction_db.h"
 
 using std::cout;
 using std::endl;
 
 namespace ycsbc {
 
+struct RocksDBPerfStats;
+
 class RocksDB : public DB {
 public:
   RocksDB(utils::Properties &props, bool preloaded);
@@ -30,6 +39,15 @@ public:
            const std::vector<std::string> *fields,
            std::vector<KVPair> &result);
 
+  bool LastValue(std::string_view &value);
+
+  int MultiRead(const std::string &table,
+                const std::vector<std::string> &keys,
+                const std::vector<std::string> *fields,
+                std::vector<std::vector<KVPair>> &result);
+
+  bool LastMultiReadValue(size_t index, std::string_view &value);
+
   int Scan(const std::string &table, const std::string &key,
            int len, const std::vector<std::string> *fields,
            std::vector<std::vector<KVPair>> &result);
@@ -37,19 +55,111 @@ public:
   int Update(const std::string &table, const std::string &key,
              std::vector<KVPair> &values);
 
+  int Merge(const std::string &table, const std::string &key,
+            std::vector<KVPair> &values);
+
   int Insert(const std::string &table, const std::string &key,
              std::vector<KVPair> &values);
 
   int Delete(const std::string &table, const std::string &key);
 
+  int ExecuteTransaction(const std::string &table,
+                         const std::vector<std::string> &keys,
+                         const std::vector<std::string> *fields,
+                         std::vector<KVPair> &values);
+
+  int BulkInsert(const std::string &table, const std::string &key,
+                 std::vector<KVPair> &values);
+
+  void FinishBulkLoad();
+
+  void PrintStats();
+
 private:
 
   void InitializeOptions(utils::Properties &props);
 
+  rocksdb::ColumnFamilyHandle *ColumnFamily(const std::string &table);
+
+  void WriteRecord(rocksdb::ColumnFamilyHandle *cf, const std::string &key,
+                   const std::string &record);
+  void AddedToBatch();
+  void CommitBatchIfDue();
+  void CommitBatch();
+
+  bool ScanUpperBound(const std::string &key, int len, std::string &bound);
+
+  void StartBulkLoadFile(rocksdb::ColumnFamilyHandle *cf);
+  void FinishBulkLoadFile();
+
+  void PrintStatistics();
+  void PrintWriteAmplification();
+  uint64_t FlushCompactionBytes();
+  void PrintPerfStats();
+
   rocksdb::DB *db;
   rocksdb::Options options;
   rocksdb::ReadOptions roptions;
+  rocksdb::ReadOptions mgoptions;
+  rocksdb::ReadOptions soptions;
   rocksdb::WriteOptions woptions;
+
+  // Set when rocksdb.merge_operator is "counter": each merge adds 1 to a
+  // counter field of the record
+  bool counter_merge;
+
+  // Records are encoded with RecordCodec. Updates of fewer than field_count
+  // fields read the record, patch it and write it back.
+  size_t field_count;
+
+  // With rocksdb.transactions, one of these is the same object as db
+  rocksdb::TransactionDB *txn_db;
+  rocksdb::OptimisticTransactionDB *optimistic_txn_db;
+  rocksdb::TransactionOptions txn_options;
+  rocksdb::OptimisticTransactionOptions optimistic_txn_options;
+  utils::Histogram txn_commit_latency;
+
+  // With column_family_per_table, each table is stored in a column family of
+  // the same name, created on first use with the same options as the default.
+  bool column_family_per_table;
+  std::mutex column_families_mutex;
+  std::map<std::string, rocksdb::ColumnFamilyHandle *> column_families;
+
+  // Each thread reuses one scan iterator, refreshed every scan_refresh_interval
+  // scans (0 creates a new iterator per scan). With a non-zero
+  // scan_upper_bound_stride, each scan is bounded above by its start key
+  // plus len * scan_upper_bound_stride, and gets a new iterator.
+  uint64_t scan_refresh_interval;
+  uint64_t scan_upper_bound_stride;
+
+  // Writes are grouped into a WriteBatch per thread, committed once it holds
+  // batch_size records or, as checked by every operation of the thread, its
+  // oldest record has waited batch_ns nanoseconds
+  uint64_t batch_size;
+  uint64_t batch_ns;
+  std::mutex stats_mutex;
+  utils::Histogram commit_latency;
+  uint64_t batch_count;
+
+  // Statistics are reset after every phase. Write amplification, which
+  // needs no statistics, is also reported since the database was opened:
+  // user_bytes counts the keys and values written in the phase, and
+  // total_flush_compaction_bytes is as of the end of the last phase.
+  uint64_t user_bytes;
+  uint64_t total_user_bytes;
+  uint64_t total_flush_compaction_bytes;
+
+  // Every perf_sample_rate-th operation of a thread is run with PerfContext
+  // and IOStatsContext enabled (0 disables sampling)
+  uint64_t perf_sample_rate;
+  std::unique_ptr<RocksDBPerfStats> perf_stats;
+
+  // SST files written by bulk loading threads, ingested by FinishBulkLoad()
+  std::string bulk_load_dir;
+  uint64_t bulk_load_file_size;
+  std::atomic<uint64_t> bulk_load_file_count;
+  std::mutex bulk_load_mutex;
+  std::map<rocksdb::ColumnFamilyHandle *, std::vector<std::string>> bulk_load_files;
 };
 
 } // ycsbc
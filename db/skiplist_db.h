@@ -0,0 +1,69 @@
+//
+//  skiplist_db.h
+//  YCSB-C
+//
+
+#ifndef YCSB_C_SKIPLIST_DB_H_
+#define YCSB_C_SKIPLIST_DB_H_
+
+#include "db/hashtable_db.h"
+
+#include <string>
+#include <vector>
+#include "lib/skiplist_hashtable.h"
+
+namespace ycsbc {
+
+///
+/// In-memory records in an ordered skiplist, so that scans (workload E)
+/// return the records that follow the start key, in key order.
+///
+template <class MA = MemAlloc>
+class SkipListDB : public HashtableDB {
+ public:
+  SkipListDB() : HashtableDB(NewKeyHashtable<HashtableDB::FieldHashtable *>()) { }
+
+  ~SkipListDB() {
+    vmp::Epoch::Drain();
+    std::vector<KeyHashtable::KVPair> key_pairs = key_table_->Entries();
+    for (auto &key_pair : key_pairs) {
+      DeleteFieldHashtable(key_pair.second);
+    }
+    delete key_table_;
+  }
+
+  ///
+  /// Makes the table of keys, for records held as V.
+  ///
+  template <class V>
+  static vmp::StringHashtable<V> *NewKeyHashtable() {
+    return new vmp::SkipListHashtable<V, MA>;
+  }
+
+ protected:
+  HashtableDB::FieldHashtable *NewFieldHashtable() {
+    return new vmp::SkipListHashtable<const char *, MA>;
+  }
+
+  void DeleteFieldHashtable(HashtableDB::FieldHashtable *table) {
+    std::vector<FieldHashtable::KVPair> pairs = table->Entries();
+    for (auto &pair : pairs) {
+      DeleteString(pair.second);
+    }
+    delete table;
+  }
+
+  const char *CopyString(const std::string &str) {
+    char *value = (char *)MA::Malloc(str.length() + 1);
+    strcpy(value, str.c_str());
+    return value;
+  }
+
+  void DeleteString(const char *str) {
+    MA::Free(str, strlen(str) + 1);
+  }
+};
+
+} // ycsbc
+
+#endif // YCSB_C_SKIPLIST_DB_H_
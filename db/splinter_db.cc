@@ -7,22 +7,149 @@
 //
 
 #include "db/splinter_db.h"
+#include "core/core_workload.h"
+#include "core/record_codec.h"
 extern "C" {
+#include "splinterdb/data.h"
 #include "splinterdb/default_data_config.h"
 }
 
 #include <string>
 #include <vector>
+#include <memory>
+#include <cstring>
+#include <cstdio>
+#include <fstream>
+#include <unistd.h>
 
+using std::cerr;
 using std::string;
 using std::vector;
 
 namespace ycsbc {
 
-SplinterDB::SplinterDB(utils::Properties &props, bool preloaded) {
+//
+// State private to each client thread, set up by Init() and torn down by Close().
+// The lookup result, and its buffer, are reused by every Read() of the thread.
+//
+struct SplinterDBThreadState {
+  std::unique_ptr<char[]>  lookup_buffer;
+  splinterdb_lookup_result lookup_result;
+  std::string_view         last_value;
+  std::string              record; // encoded record being written
+  uint64_t                 bytes_read = 0;
+  uint64_t                 bytes_written = 0;
+};
+
+static thread_local SplinterDBThreadState *thread_state = NULL;
+
+//
+// Reads the bytes this process has fetched from and sent to storage. This
+// covers every file the process touches, not just the SplinterDB device.
+//
+static void ReadProcessIO(uint64_t &read_bytes, uint64_t &write_bytes)
+{
+  read_bytes = write_bytes = 0;
+  std::ifstream io("/proc/self/io");
+  string name;
+  uint64_t value;
+  while (io >> name >> value) {
+    if (name == "read_bytes:") {
+      read_bytes = value;
+    } else if (name == "write_bytes:") {
+      write_bytes = value;
+    }
+  }
+}
+
+//
+// SplinterDB prints its statistics to stdout. They are captured and copied
+// to the results, on stderr, as comment lines.
+//
+static void PrintCommented(void (*print)(const splinterdb *), const splinterdb *spl)
+{
+  fflush(stdout);
+  FILE *capture = tmpfile();
+  if (!capture) {
+    print(spl);
+    return;
+  }
+  int saved_stdout = dup(STDOUT_FILENO);
+  dup2(fileno(capture), STDOUT_FILENO);
+  print(spl);
+  fflush(stdout);
+  dup2(saved_stdout, STDOUT_FILENO);
+  close(saved_stdout);
+
+  rewind(capture);
+  char *line = NULL;
+  size_t line_size = 0;
+  ssize_t len;
+  while ((len = getline(&line, &line_size, capture)) != -1) {
+    cerr << "# " << string(line, len);
+  }
+  free(line);
+  fclose(capture);
+}
+
+//
+// An update message is a record holding the updated fields. Merging it into
+// an older message sets those fields in the older record; merging it into a
+// delete, or into nothing, makes it the whole record.
+//
+static int PatchRecord(merge_accumulator *acc, slice base, message_type type)
+{
+  // The patch is overwritten by the result, so the result is built aside
+  static thread_local string record;
+  record.assign((const char *)slice_data(base), slice_length(base));
+  RecordCodec::Patch(record, std::string_view((const char *)merge_accumulator_data(acc),
+                                              merge_accumulator_length(acc)));
+  if (!merge_accumulator_resize(acc, record.size())) {
+    return -1;
+  }
+  memcpy(merge_accumulator_data(acc), record.data(), record.size());
+  merge_accumulator_set_class(acc, type);
+  return 0;
+}
+
+static int MergePatches(const data_config *cfg, slice key, message old_message,
+                        merge_accumulator *new_message)
+{
+  switch (message_class(old_message)) {
+    case MESSAGE_TYPE_INSERT:
+    case MESSAGE_TYPE_UPDATE:
+      return PatchRecord(new_message, message_slice(old_message), message_class(old_message));
+    case MESSAGE_TYPE_DELETE:
+      merge_accumulator_set_class(new_message, MESSAGE_TYPE_INSERT);
+      return 0;
+    default:
+      return -1;
+  }
+}
+
+static int MergePatchesFinal(const data_config *cfg, slice key, merge_accumulator *oldest_message)
+{
+  merge_accumulator_set_class(oldest_message, MESSAGE_TYPE_INSERT);
+  return 0;
+}
+
+SplinterDB::SplinterDB(utils::Properties &props, bool preloaded)
+  : user_bytes_read(0), user_bytes_written(0)
+{
   uint64_t max_key_size = props.GetIntProperty("splinterdb.max_key_size");
 
   default_data_config_init(max_key_size, &data_cfg);
+  string update_mode = props.GetProperty("splinterdb.update_mode");
+  if (update_mode == "message") {
+    update_messages = true;
+    data_cfg.merge_tuples = MergePatches;
+    data_cfg.merge_tuples_final = MergePatchesFinal;
+  } else if (update_mode == "insert") {
+    update_messages = false;
+  } else {
+    cout << "Unknown splinterdb.update_mode " << update_mode << endl;
+    assert(0);
+  }
   splinterdb_cfg.filename                 = props.GetProperty("splinterdb.filename").c_str();
   splinterdb_cfg.cache_size               = props.GetIntProperty("splinterdb.cache_size_mb") * 1024 *1024;
   splinterdb_cfg.disk_size                = props.GetIntProperty("splinterdb.disk_size_gb") * 1024 * 1024 * 1024;
@@ -45,12 +172,15 @@ SplinterDB::SplinterDB(utils::Properties &props, bool preloaded) {
   splinterdb_cfg.max_branches_per_node    = props.GetIntProperty("splinterdb.max_branches_per_node");
   splinterdb_cfg.use_stats                = props.GetIntProperty("splinterdb.use_stats");
   splinterdb_cfg.reclaim_threshold        = props.GetIntProperty("splinterdb.reclaim_threshold");
+  lookup_buffer_size                      = props.GetIntProperty("splinterdb.lookup_buffer_size");
+  field_count                             = props.GetIntProperty(CoreWorkload::FIELD_COUNT_PROPERTY);
 
   if (preloaded) {
     assert(!splinterdb_open(&splinterdb_cfg, &spl));
   } else {
     assert(!splinterdb_create(&splinterdb_cfg, &spl));
   }
+  ReadProcessIO(io_bytes_read, io_bytes_written);
 }
 
 SplinterDB::~SplinterDB()
@@ -61,10 +191,22 @@ SplinterDB::~SplinterDB()
 void SplinterDB::Init()
 {
   splinterdb_register_thread(spl);
+  thread_state = new SplinterDBThreadState();
+  thread_state->lookup_buffer.reset(new char[lookup_buffer_size]);
+  splinterdb_lookup_result_init(spl, &thread_state->lookup_result,
+                                lookup_buffer_size, thread_state->lookup_buffer.get());
 }
 
 void SplinterDB::Close()
 {
+  splinterdb_lookup_result_deinit(&thread_state->lookup_result);
+  {
+    std::lock_guard<std::mutex> lock(stats_mutex);
+    user_bytes_read += thread_state->bytes_read;
+    user_bytes_written += thread_state->bytes_written;
+  }
+  delete thread_state;
+  thread_state = NULL;
   splinterdb_deregister_thread(spl);
 }
 
@@ -72,20 +214,41 @@ int SplinterDB::Read(const string &table,
                      const string &key,
                      const vector<string> *fields,
                      vector<KVPair> &result) {
-  splinterdb_lookup_result  lookup_result;
-  splinterdb_lookup_result_init(spl, &lookup_result, 0, NULL);
+  splinterdb_lookup_result *lookup_result = &thread_state->lookup_result;
   slice key_slice = slice_create(key.size(), key.c_str());
   //cout << "lookup " << key << endl;
-  assert(!splinterdb_lookup(spl, key_slice, &lookup_result));
-  if (!splinterdb_lookup_found(&lookup_result)) {
+  assert(!splinterdb_lookup(spl, key_slice, lookup_result));
+  if (!splinterdb_lookup_found(lookup_result)) {
     cout << "FAILED lookup " << key << endl;
     assert(0);
   }
   //cout << "done lookup " << key << endl;
-  splinterdb_lookup_result_deinit(&lookup_result);
+  slice value;
+  int rc = splinterdb_lookup_result_value(lookup_result, &value);
+  assert(!rc);
+  std::string_view record((const char *)slice_data(value), slice_length(value));
+  thread_state->bytes_read += key.size() + record.size();
+
+  // A single requested field is handed back on its own
+  size_t index;
+  if (fields && fields->size() == 1) {
+    RecordCodec::FieldView field;
+    if (RecordCodec::Find(record, (*fields)[0], index) &&
+        RecordCodec::Field(record, index, field)) {
+      record = field.second;
+    } else {
+      record = std::string_view();
+    }
+  }
+  thread_state->last_value = record;
   return DB::kOK;
 }
 
+bool SplinterDB::LastValue(std::string_view &value) {
+  value = thread_state->last_value;
+  return value.data() != NULL;
+}
+
 int SplinterDB::Scan(const string &table,
                      const string &key, int len,
                      const vector<string> *fields,
@@ -102,6 +265,7 @@ int SplinterDB::Scan(const string &table,
     }
     slice key, val;
     splinterdb_iterator_get_current(itor, &key, &val);
+    thread_state->bytes_read += slice_length(key) + slice_length(val);
     splinterdb_iterator_next(itor);
   }
   assert(!splinterdb_iterator_status(itor));
@@ -110,21 +274,68 @@ int SplinterDB::Scan(const string &table,
   return DB::kOK;
 }
 
+//
+// Without update messages, updates of some of the fields read the record,
+// patch it and insert it back.
+//
 int SplinterDB::Update(const string &table,
                        const string &key,
                        vector<KVPair> &values) {
-  return Insert(table, key, values);
+  if (values.size() >= field_count) {
+    return Insert(table, key, values);
+  }
+
+  string &record = thread_state->record;
+  slice key_slice = slice_create(key.size(), key.c_str());
+  if (update_messages) {
+    RecordCodec::Encode(values, record);
+    slice delta_slice = slice_create(record.size(), record.c_str());
+    int rc = splinterdb_update(spl, key_slice, delta_slice);
+    assert(!rc);
+  } else {
+    splinterdb_lookup_result *lookup_result = &thread_state->lookup_result;
+    int rc = splinterdb_lookup(spl, key_slice, lookup_result);
+    assert(!rc);
+    if (splinterdb_lookup_found(lookup_result)) {
+      slice value;
+      rc = splinterdb_lookup_result_value(lookup_result, &value);
+      assert(!rc);
+      record.assign((const char *)slice_data(value), slice_length(value));
+      thread_state->bytes_read += key.size() + record.size();
+      RecordCodec::Patch(record, values);
+    } else {
+      RecordCodec::Encode(values, record);
+    }
+    slice val_slice = slice_create(record.size(), record.c_str());
+    rc = splinterdb_insert(spl, key_slice, val_slice);
+    assert(!rc);
+  }
+  thread_state->bytes_written += key.size() + record.size();
+
+  return DB::kOK;
 }
 
-int SplinterDB::Insert(const string &table, const string &key, vector<KVPair> &values) {
-  assert(values.size() == 1);
+//
+// With update messages a read-modify-write needs no read.
+//
+int SplinterDB::Merge(const string &table,
+                      const string &key,
+                      vector<KVPair> &values) {
+  if (!update_messages) {
+    return DB::Merge(table, key, values);
+  }
+  return Update(table, key, values);
+}
 
-  std::string val = values[0].second;
+int SplinterDB::Insert(const string &table, const string &key, vector<KVPair> &values) {
+  string &val = thread_state->record;
+  RecordCodec::Encode(values, val);
   slice key_slice = slice_create(key.size(), key.c_str());
   slice val_slice = slice_create(val.size(), val.c_str());
   //cout << "insert " << key << endl;
   assert(!splinterdb_insert(spl, key_slice, val_slice));
   //cout << "done insert " << key << endl;
+  thread_state->bytes_written += key.size() + val.size();
 
   return DB::kOK;
 }
@@ -132,8 +343,46 @@ int SplinterDB::Insert(const string &table, const string &key, vector<KVPair> &v
 int SplinterDB::Delete(const string &table, const string &key) {
   slice key_slice = slice_create(key.size(), key.c_str());
   assert(!splinterdb_delete(spl, key_slice));
+  thread_state->bytes_written += key.size();
 
   return DB::kOK;
 }
 
+//
+// Amplification compares the storage I/O of the whole process during the
+// phase with the bytes of keys and values the clients read and wrote.
+// Cache hit and miss counts are not printed: the public SplinterDB API has
+// no call to read or reset them; with splinterdb.cache_use_stats set,
+// SplinterDB only logs them itself.
+//
+void SplinterDB::PrintStats() {
+  std::lock_guard<std::mutex> lock(stats_mutex);
+  if (splinterdb_cfg.use_stats) {
+    cerr << "# SplinterDB insertion statistics" << endl;
+    PrintCommented(splinterdb_stats_print_insertion, spl);
+    cerr << "# SplinterDB lookup statistics" << endl;
+    PrintCommented(splinterdb_stats_print_lookup, spl);
+    splinterdb_stats_reset(spl);
+  }
+
+  uint64_t read_bytes, write_bytes;
+  ReadProcessIO(read_bytes, write_bytes);
+  uint64_t phase_read = read_bytes - io_bytes_read;
+  uint64_t phase_written = write_bytes - io_bytes_written;
+  cerr << "# Process I/O bytes read:\t" << phase_read << endl;
+  cerr << "# Process I/O bytes written:\t" << phase_written << endl;
+  if (user_bytes_read) {
+    cerr << "# SplinterDB read amplification (process I/O):\t"
+         << (double)phase_read / user_bytes_read << endl;
+  }
+  if (user_bytes_written) {
+    cerr << "# SplinterDB write amplification (process I/O):\t"
+         << (double)phase_written / user_bytes_written << endl;
+  }
+  io_bytes_read = read_bytes;
+  io_bytes_written = write_bytes;
+  user_bytes_read = 0;
+  user_bytes_written = 0;
+}
+
 } // ycsbc
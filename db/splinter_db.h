@@ -10,6 +10,7 @@
 
 #include <iostream>
 #include <string>
+#include <mutex>
 #include "core/properties.h"
 
 extern "C" {
@@ -33,6 +34,8 @@ public:
            const std::vector<std::string> *fields,
            std::vector<KVPair> &result);
 
+  bool LastValue(std::string_view &value);
+
   int Scan(const std::string &table, const std::string &key,
            int len, const std::vector<std::string> *fields,
            std::vector<std::vector<KVPair>> &result);
@@ -40,15 +43,40 @@ public:
   int Update(const std::string &table, const std::string &key,
              std::vector<KVPair> &values);
 
+  int Merge(const std::string &table, const std::string &key,
+            std::vector<KVPair> &values);
+
   int Insert(const std::string &table, const std::string &key,
              std::vector<KVPair> &values);
 
   int Delete(const std::string &table, const std::string &key);
 
+  void PrintStats();
+
 private:
   splinterdb_config         splinterdb_cfg;
   data_config               data_cfg;
   splinterdb               *spl;
+
+  // Size of each thread's lookup result buffer; larger values are allocated
+  uint64_t                  lookup_buffer_size;
+
+  // Records are encoded with RecordCodec; updates of fewer fields than this
+  // patch the stored record
+  size_t                    field_count;
+
+  // With splinterdb.update_mode=message, updates are sent as blind messages
+  // holding the updated fields, merged into the record by SplinterDB when it
+  // is read or compacted
+  bool                      update_messages;
+
+  // Bytes of keys and values the clients read and wrote, and the process's
+  // storage I/O counters when the last phase ended, for amplification
+  std::mutex                stats_mutex;
+  uint64_t                  user_bytes_read;
+  uint64_t                  user_bytes_written;
+  uint64_t                  io_bytes_read;
+  uint64_t                  io_bytes_written;
 };
 
 } // ycsbc
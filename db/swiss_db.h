@@ -0,0 +1,71 @@
+//
+//  swiss_db.h
+//  YCSB-C
+//
+
+#ifndef YCSB_C_SWISS_DB_H_
+#define YCSB_C_SWISS_DB_H_
+
+#include "db/hashtable_db.h"
+
+#include <string>
+#include <vector>
+#include "lib/swiss_hashtable.h"
+
+namespace ycsbc {
+
+///
+/// In-memory records in Swiss tables: lock-free reads and per-segment
+/// write locks for the keys, and a one-segment table for each record's fields.
+///
+template <class MA = MemAlloc>
+class SwissDB : public HashtableDB {
+ public:
+  SwissDB() : HashtableDB(NewKeyHashtable<HashtableDB::FieldHashtable *>()) { }
+
+  ~SwissDB() {
+    vmp::Epoch::Drain();
+    std::vector<KeyHashtable::KVPair> key_pairs = key_table_->Entries();
+    for (auto &key_pair : key_pairs) {
+      DeleteFieldHashtable(key_pair.second);
+    }
+    delete key_table_;
+  }
+
+  ///
+  /// Makes the table of keys, for records held as V.
+  ///
+  template <class V>
+  static vmp::StringHashtable<V> *NewKeyHashtable() {
+    return new vmp::SwissHashtable<V, MA>(kSegments);
+  }
+
+ protected:
+  static const std::size_t kSegments = 1024;
+
+  HashtableDB::FieldHashtable *NewFieldHashtable() {
+    return new vmp::SwissHashtable<const char *, MA>;
+  }
+
+  void DeleteFieldHashtable(HashtableDB::FieldHashtable *table) {
+    std::vector<FieldHashtable::KVPair> pairs = table->Entries();
+    for (auto &pair : pairs) {
+      DeleteString(pair.second);
+    }
+    delete table;
+  }
+
+  const char *CopyString(const std::string &str) {
+    char *value = (char *)MA::Malloc(str.length() + 1);
+    strcpy(value, str.c_str());
+    return value;
+  }
+
+  void DeleteString(const char *str) {
+    MA::Free(str, strlen(str) + 1);
+  }
+};
+
+} // ycsbc
+
+#endif // YCSB_C_SWISS_DB_H_
@@ -17,12 +17,13 @@
 
 namespace ycsbc {
 
+template <class MA = MemAlloc>
 class TbbRandDB : public HashtableDB {
  public:
-  TbbRandDB() : HashtableDB(
-      new vmp::TbbRandHashtable<HashtableDB::FieldHashtable *>) { }
+  TbbRandDB() : HashtableDB(NewKeyHashtable<HashtableDB::FieldHashtable *>()) { }
 
   ~TbbRandDB() {
+    vmp::Epoch::Drain();
     std::vector<KeyHashtable::KVPair> key_pairs = key_table_->Entries();
     for (auto &key_pair : key_pairs) {
       DeleteFieldHashtable(key_pair.second);
@@ -30,9 +31,17 @@ class TbbRandDB : public HashtableDB {
     delete key_table_;
   }
 
+  ///
+  /// Makes the table of keys, for records held as V.
+  ///
+  template <class V>
+  static vmp::StringHashtable<V> *NewKeyHashtable() {
+    return new vmp::TbbRandHashtable<V, MA>;
+  }
+
  protected:
   HashtableDB::FieldHashtable *NewFieldHashtable() {
-    return new vmp::TbbRandHashtable<const char *>;
+    return new vmp::TbbRandHashtable<const char *, MA>;
   }
 
   void DeleteFieldHashtable(HashtableDB::FieldHashtable *table) {
@@ -44,13 +53,13 @@ class TbbRandDB : public HashtableDB {
   }
 
   const char *CopyString(const std::string &str) {
-    char *value = new char[str.length() + 1];
+    char *value = (char *)MA::Malloc(str.length() + 1);
     strcpy(value, str.c_str());
     return value;
   }
 
   void DeleteString(const char *str) {
-    delete[] str;
+    MA::Free(str, strlen(str) + 1);
   }
 };
 
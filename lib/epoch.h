@@ -0,0 +1,226 @@
+//
+// epoch.h
+//
+// Epoch-based reclamation: memory that concurrent readers may still hold is
+// retired rather than freed, and freed in batches once every thread that
+// could have seen it has left the epoch it was retired in.
+//
+
+#ifndef YCSB_C_LIB_EPOCH_H_
+#define YCSB_C_LIB_EPOCH_H_
+
+#include <atomic>
+#include <cstdint>
+#include <mutex>
+#include <vector>
+
+namespace vmp {
+
+///
+/// Code that reads shared memory holds an EpochGuard while it does, and code
+/// that unlinks that memory hands it to Retire() instead of freeing it.
+/// A global epoch advances once every thread inside a guard has seen the
+/// current one; memory retired in epoch e is freed once the global epoch
+/// reaches e + 2, when no guard that could still reach it remains.
+///
+/// Guards nest, and only the outermost one announces the thread's epoch.
+/// Each thread frees its own retired memory, every kBatch retirements; what
+/// is left when a thread exits is freed by other threads later, or by
+/// Drain().
+///
+class Epoch {
+ public:
+  typedef void (*Deleter)(void *p, void *arg);
+
+  static void Enter();
+  static void Exit();
+
+  ///
+  /// Calls deleter(p, arg) once no thread can still be reading p.
+  ///
+  static void Retire(void *p, Deleter deleter, void *arg = NULL);
+
+  ///
+  /// Frees everything retired by this thread and by threads that have
+  /// exited. Only safe while no other thread is inside a guard, e.g. when
+  /// the structures that retired the memory are being destroyed.
+  ///
+  static void Drain();
+
+ private:
+  static const uint64_t kInactive = UINT64_MAX;
+  static const std::size_t kBatch = 256;
+
+  struct Retired {
+    void *p;
+    Deleter deleter;
+    void *arg;
+    uint64_t epoch;
+  };
+
+  struct alignas(64) ThreadRecord {
+    std::atomic<uint64_t> epoch;
+    std::atomic<bool> in_use;
+    ThreadRecord *next;
+    unsigned depth;
+    std::size_t retired; ///< Count, to collect every kBatch retirements
+    std::vector<Retired> limbo; ///< In the order retired, so by epoch
+  };
+
+  struct LocalRecord {
+    ThreadRecord *record;
+    LocalRecord();
+    ~LocalRecord();
+  };
+
+  static ThreadRecord *Local() {
+    thread_local LocalRecord local;
+    return local.record;
+  }
+
+  static bool TryAdvance();
+  static void Collect(std::vector<Retired> &limbo);
+  static void FreeAll(std::vector<Retired> &limbo);
+
+  inline static std::atomic<uint64_t> global_epoch_{0};
+  inline static std::atomic<ThreadRecord *> records_{nullptr};
+  inline static std::mutex orphans_mutex_;
+  inline static std::vector<Retired> orphans_;
+};
+
+///
+/// Holds the calling thread inside an epoch for its scope.
+///
+class EpochGuard {
+ public:
+  EpochGuard() { Epoch::Enter(); }
+  ~EpochGuard() { Epoch::Exit(); }
+
+  EpochGuard(const EpochGuard &) = delete;
+  EpochGuard &operator=(const EpochGuard &) = delete;
+};
+
+//
+// Thread records are never freed: a thread takes over the record of one that
+// has exited, or adds a new one to the list.
+//
+inline Epoch::LocalRecord::LocalRecord() {
+  for (ThreadRecord *r = records_.load(std::memory_order_acquire); r;
+       r = r->next) {
+    bool free = false;
+    if (!r->in_use.load(std::memory_order_relaxed) &&
+        r->in_use.compare_exchange_strong(free, true)) {
+      record = r;
+      return;
+    }
+  }
+  record = new ThreadRecord;
+  record->epoch.store(kInactive, std::memory_order_relaxed);
+  record->in_use.store(true, std::memory_order_relaxed);
+  record->depth = 0;
+  record->retired = 0;
+  record->next = records_.load(std::memory_order_relaxed);
+  while (!records_.compare_exchange_weak(record->next, record)) { }
+}
+
+inline Epoch::LocalRecord::~LocalRecord() {
+  if (!record->limbo.empty()) {
+    std::lock_guard<std::mutex> lock(orphans_mutex_);
+    orphans_.insert(orphans_.end(), record->limbo.begin(), record->limbo.end());
+    record->limbo.clear();
+  }
+  record->in_use.store(false, std::memory_order_release);
+}
+
+inline void Epoch::Enter() {
+  ThreadRecord *record = Local();
+  if (record->depth++) return;
+  // Re-announce until the epoch announced is still the current one, so the
+  // epoch cannot have advanced past it unseen
+  uint64_t epoch = global_epoch_.load(std::memory_order_relaxed);
+  while (true) {
+    record->epoch.store(epoch, std::memory_order_seq_cst);
+    uint64_t now = global_epoch_.load(std::memory_order_seq_cst);
+    if (now == epoch) break;
+    epoch = now;
+  }
+}
+
+inline void Epoch::Exit() {
+  ThreadRecord *record = Local();
+  if (--record->depth) return;
+  record->epoch.store(kInactive, std::memory_order_release);
+}
+
+inline void Epoch::Retire(void *p, Deleter deleter, void *arg) {
+  ThreadRecord *record = Local();
+  record->limbo.push_back(
+      {p, deleter, arg, global_epoch_.load(std::memory_order_seq_cst)});
+  if (++record->retired % kBatch == 0) {
+    TryAdvance();
+    Collect(record->limbo);
+    std::vector<Retired> orphans;
+    {
+      std::unique_lock<std::mutex> lock(orphans_mutex_, std::try_to_lock);
+      if (lock.owns_lock()) orphans.swap(orphans_);
+    }
+    if (!orphans.empty()) {
+      Collect(orphans);
+      record->limbo.insert(record->limbo.begin(), orphans.begin(),
+                           orphans.end());
+    }
+  }
+}
+
+inline void Epoch::Drain() {
+  std::vector<Retired> orphans;
+  {
+    std::lock_guard<std::mutex> lock(orphans_mutex_);
+    orphans.swap(orphans_);
+  }
+  FreeAll(orphans);
+  FreeAll(Local()->limbo);
+}
+
+//
+// Advances the global epoch if every thread inside a guard has announced it.
+//
+inline bool Epoch::TryAdvance() {
+  uint64_t epoch = global_epoch_.load(std::memory_order_seq_cst);
+  for (ThreadRecord *r = records_.load(std::memory_order_acquire); r;
+       r = r->next) {
+    uint64_t announced = r->epoch.load(std::memory_order_seq_cst);
+    if (announced != kInactive && announced != epoch) return false;
+  }
+  return global_epoch_.compare_exchange_strong(epoch, epoch + 1);
+}
+
+//
+// Frees the memory at the front of limbo that was retired two or more
+// epochs ago. Deleters may retire more memory, so they run on a copy.
+//
+inline void Epoch::Collect(std::vector<Retired> &limbo) {
+  uint64_t epoch = global_epoch_.load(std::memory_order_seq_cst);
+  std::size_t n = 0;
+  while (n < limbo.size() && limbo[n].epoch + 2 <= epoch) ++n;
+  if (!n) return;
+  std::vector<Retired> ready(limbo.begin(), limbo.begin() + n);
+  limbo.erase(limbo.begin(), limbo.begin() + n);
+  for (Retired &retired : ready) {
+    retired.deleter(retired.p, retired.arg);
+  }
+}
+
+inline void Epoch::FreeAll(std::vector<Retired> &limbo) {
+  while (!limbo.empty()) {
+    std::vector<Retired> ready;
+    ready.swap(limbo);
+    for (Retired &retired : ready) {
+      retired.deleter(retired.p, retired.arg);
+    }
+  }
+}
+
+} // vmp
+
+#endif // YCSB_C_LIB_EPOCH_H_
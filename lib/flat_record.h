@@ -0,0 +1,244 @@
+//
+// flat_record.h
+//
+// A record of named fields laid out in one allocation: a header, a directory
+// of fields, then the field names and values inline.
+//
+
+#ifndef YCSB_C_LIB_FLAT_RECORD_H_
+#define YCSB_C_LIB_FLAT_RECORD_H_
+
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <new>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace vmp {
+
+///
+/// Each field's value has room for its length when the record was built,
+/// rounded up to kValueAlign, so updates that fit are written in place.
+///
+/// The version is a seqlock: writers make it odd, with Lock(), while they
+/// change values, and Read() waits for it to be even, copies the fields out
+/// and retries if it changed meanwhile. A writer whose values do not fit
+/// builds a bigger copy of the record and marks this one obsolete, as does
+/// a writer deleting it; writers that then lock it must look the record up
+/// again.
+///
+class FlatRecord {
+ public:
+  typedef std::pair<std::string, std::string> Field;
+
+  ///
+  /// Bytes needed for a record of these fields.
+  ///
+  static std::size_t SizeFor(const std::vector<Field> &fields);
+
+  ///
+  /// Builds a record of fields in memory of SizeFor(fields) bytes.
+  ///
+  static FlatRecord *Build(void *memory, const std::vector<Field> &fields);
+
+  std::size_t size() const { return size_; }
+  std::size_t num_fields() const { return num_fields_; }
+
+  ///
+  /// Copies the named fields, or all of them when fields is NULL, into
+  /// result, skipping names the record does not have. Returns how many
+  /// times the copy was retried because of a concurrent writer.
+  ///
+  unsigned Read(const std::vector<std::string> *fields,
+                std::vector<Field> &result) const;
+
+  void Lock();
+  void Unlock() { version_.fetch_add(1, std::memory_order_release); }
+
+  ///
+  /// With the record locked: writes values in place and returns true if each
+  /// names an existing field and fits, or else changes nothing.
+  ///
+  bool Write(const std::vector<Field> &values);
+
+  ///
+  /// With the record locked: all fields, with values replacing those of the
+  /// same name and new names appended, to build the record's successor from.
+  ///
+  std::vector<Field> Merge(const std::vector<Field> &values) const;
+
+  bool obsolete() const { return obsolete_; }
+  void set_obsolete() { obsolete_ = true; }
+
+ private:
+  static const std::size_t kValueAlign = 8;
+
+  struct Entry {
+    uint32_t name;     ///< Offset of the NUL-terminated name
+    uint32_t value;    ///< Offset of the value
+    uint32_t length;   ///< Length of the value
+    uint32_t capacity; ///< Room for the value
+  };
+
+  FlatRecord() { }
+
+  Entry *entries() { return (Entry *)(this + 1); }
+  const Entry *entries() const { return (const Entry *)(this + 1); }
+  const char *name(const Entry &entry) const {
+    return (const char *)this + entry.name;
+  }
+  char *value(const Entry &entry) { return (char *)this + entry.value; }
+  const char *value(const Entry &entry) const {
+    return (const char *)this + entry.value;
+  }
+
+  int Find(const std::string &field) const;
+
+  std::atomic<uint32_t> version_;
+  uint32_t size_;
+  uint16_t num_fields_;
+  bool obsolete_;
+};
+
+static_assert(sizeof(FlatRecord) % alignof(uint32_t) == 0,
+              "the field directory follows the header aligned");
+
+inline std::size_t FlatRecord::SizeFor(const std::vector<Field> &fields) {
+  std::size_t size = sizeof(FlatRecord) + fields.size() * sizeof(Entry);
+  for (const Field &field : fields) {
+    size += field.first.size() + 1;
+  }
+  size = (size + kValueAlign - 1) & ~(kValueAlign - 1);
+  for (const Field &field : fields) {
+    size += (field.second.size() + kValueAlign - 1) & ~(kValueAlign - 1);
+  }
+  return size;
+}
+
+inline FlatRecord *FlatRecord::Build(void *memory,
+                                     const std::vector<Field> &fields) {
+  FlatRecord *record = new (memory) FlatRecord;
+  record->version_.store(0, std::memory_order_relaxed);
+  record->size_ = SizeFor(fields);
+  record->num_fields_ = fields.size();
+  record->obsolete_ = false;
+
+  std::size_t offset = sizeof(FlatRecord) + fields.size() * sizeof(Entry);
+  for (std::size_t i = 0; i < fields.size(); ++i) {
+    Entry &entry = record->entries()[i];
+    entry.name = offset;
+    memcpy((char *)record + offset, fields[i].first.c_str(),
+           fields[i].first.size() + 1);
+    offset += fields[i].first.size() + 1;
+  }
+  offset = (offset + kValueAlign - 1) & ~(kValueAlign - 1);
+  for (std::size_t i = 0; i < fields.size(); ++i) {
+    Entry &entry = record->entries()[i];
+    entry.value = offset;
+    entry.length = fields[i].second.size();
+    entry.capacity = (entry.length + kValueAlign - 1) & ~(kValueAlign - 1);
+    memcpy(record->value(entry), fields[i].second.data(), entry.length);
+    offset += entry.capacity;
+  }
+  return record;
+}
+
+//
+// Field names are usually "field<i>" for the i-th field, so that entry is
+// tried first, before a scan of the directory.
+//
+inline int FlatRecord::Find(const std::string &field) const {
+  std::size_t digits = field.size();
+  while (digits && field[digits - 1] >= '0' && field[digits - 1] <= '9') {
+    --digits;
+  }
+  if (digits < field.size()) {
+    std::size_t i = strtoul(field.c_str() + digits, NULL, 10);
+    if (i < num_fields_ && field == name(entries()[i])) return i;
+  }
+  for (int i = 0; i < num_fields_; ++i) {
+    if (field == name(entries()[i])) return i;
+  }
+  return -1;
+}
+
+inline unsigned FlatRecord::Read(const std::vector<std::string> *fields,
+                                 std::vector<Field> &result) const {
+  std::size_t start = result.size();
+  for (unsigned retries = 0; ; ++retries) {
+    result.resize(start);
+    uint32_t version;
+    while ((version = version_.load(std::memory_order_acquire)) & 1) {
+      std::this_thread::yield();
+    }
+
+    if (!fields) {
+      for (int i = 0; i < num_fields_; ++i) {
+        const Entry &entry = entries()[i];
+        result.emplace_back(name(entry), std::string(value(entry),
+            std::min(entry.length, entry.capacity)));
+      }
+    } else {
+      for (const std::string &field : *fields) {
+        int i = Find(field);
+        if (i < 0) continue;
+        const Entry &entry = entries()[i];
+        result.emplace_back(field, std::string(value(entry),
+            std::min(entry.length, entry.capacity)));
+      }
+    }
+
+    std::atomic_thread_fence(std::memory_order_acquire);
+    if (version_.load(std::memory_order_relaxed) == version) return retries;
+  }
+}
+
+inline void FlatRecord::Lock() {
+  uint32_t version = version_.load(std::memory_order_relaxed);
+  while ((version & 1) ||
+         !version_.compare_exchange_weak(version, version + 1,
+                                         std::memory_order_acquire)) {
+    if (version & 1) std::this_thread::yield();
+    version = version_.load(std::memory_order_relaxed);
+  }
+  std::atomic_thread_fence(std::memory_order_release);
+}
+
+inline bool FlatRecord::Write(const std::vector<Field> &values) {
+  for (const Field &field : values) {
+    int i = Find(field.first);
+    if (i < 0 || field.second.size() > entries()[i].capacity) return false;
+  }
+  for (const Field &field : values) {
+    Entry &entry = entries()[Find(field.first)];
+    memcpy(value(entry), field.second.data(), field.second.size());
+    entry.length = field.second.size();
+  }
+  return true;
+}
+
+inline std::vector<FlatRecord::Field> FlatRecord::Merge(
+    const std::vector<Field> &values) const {
+  std::vector<Field> fields;
+  for (int i = 0; i < num_fields_; ++i) {
+    const Entry &entry = entries()[i];
+    fields.emplace_back(name(entry), std::string(value(entry), entry.length));
+  }
+  for (const Field &field : values) {
+    int i = Find(field.first);
+    if (i < 0) {
+      fields.push_back(field);
+    } else {
+      fields[i].second = field.second;
+    }
+  }
+  return fields;
+}
+
+} // vmp
+
+#endif // YCSB_C_LIB_FLAT_RECORD_H_
@@ -15,8 +15,8 @@
 
 namespace vmp {
 
-template<class V>
-class LockStlHashtable : public StlHashtable<V> {
+template<class V, class MA = MemAlloc>
+class LockStlHashtable : public StlHashtable<V, MA> {
  public:
   typedef typename StringHashtable<V>::KVPair KVPair;
 
@@ -31,41 +31,41 @@ class LockStlHashtable : public StlHashtable<V> {
   mutable std::mutex mutex_;
 };
 
-template<class V>
-inline V LockStlHashtable<V>::Get(const char *key) const {
+template<class V, class MA>
+inline V LockStlHashtable<V, MA>::Get(const char *key) const {
   std::lock_guard<std::mutex> lock(mutex_);
-  return StlHashtable<V>::Get(key);
+  return StlHashtable<V, MA>::Get(key);
 }
 
-template<class V>
-inline bool LockStlHashtable<V>::Insert(const char *key, V value) {
+template<class V, class MA>
+inline bool LockStlHashtable<V, MA>::Insert(const char *key, V value) {
   std::lock_guard<std::mutex> lock(mutex_);
-  return StlHashtable<V>::Insert(key, value);
+  return StlHashtable<V, MA>::Insert(key, value);
 }
 
-template<class V>
-inline V LockStlHashtable<V>::Update(const char *key, V value) {
+template<class V, class MA>
+inline V LockStlHashtable<V, MA>::Update(const char *key, V value) {
   std::lock_guard<std::mutex> lock(mutex_);
-  return StlHashtable<V>::Update(key, value);
+  return StlHashtable<V, MA>::Update(key, value);
 }
 
-template<class V>
-inline V LockStlHashtable<V>::Remove(const char *key) {
+template<class V, class MA>
+inline V LockStlHashtable<V, MA>::Remove(const char *key) {
   std::lock_guard<std::mutex> lock(mutex_);
-  return StlHashtable<V>::Remove(key);
+  return StlHashtable<V, MA>::Remove(key);
 }
 
-template<class V>
-inline std::size_t LockStlHashtable<V>::Size() const {
+template<class V, class MA>
+inline std::size_t LockStlHashtable<V, MA>::Size() const {
   std::lock_guard<std::mutex> lock(mutex_);
-  return StlHashtable<V>::Size();
+  return StlHashtable<V, MA>::Size();
 }
 
-template<class V>
-inline std::vector<typename LockStlHashtable<V>::KVPair>
-LockStlHashtable<V>::Entries(const char *key, size_t n) const {
+template<class V, class MA>
+inline std::vector<typename LockStlHashtable<V, MA>::KVPair>
+LockStlHashtable<V, MA>::Entries(const char *key, size_t n) const {
   std::lock_guard<std::mutex> lock(mutex_);
-  return StlHashtable<V>::Entries(key, n);
+  return StlHashtable<V, MA>::Entries(key, n);
 }
 
 } // vmp
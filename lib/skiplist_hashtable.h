@@ -0,0 +1,340 @@
+//
+// skiplist_hashtable.h
+//
+// An ordered, concurrent StringHashtable: a lazy skiplist (Herlihy et al.,
+// "A Simple Optimistic Skiplist Algorithm") with lock-free Get() and
+// Entries(), and per-node locks for Insert(), Update() and Remove().
+//
+
+#ifndef YCSB_C_LIB_SKIPLIST_HASHTABLE_H_
+#define YCSB_C_LIB_SKIPLIST_HASHTABLE_H_
+
+#include "lib/string_hashtable.h"
+
+#include <atomic>
+#include <cstdint>
+#include <new>
+#include <vector>
+#include "lib/epoch.h"
+#include "lib/string.h"
+
+namespace vmp {
+
+///
+/// Keys are kept in strcmp() order, so Entries(key, n) returns the n entries
+/// at or after key in sorted order, as a range scan expects.
+///
+/// Every operation runs inside a vmp::EpochGuard, and nodes unlinked by
+/// Remove() are retired to vmp::Epoch, as concurrent Get() and Entries()
+/// calls may still be reading them. Keys returned by Entries() stay valid
+/// for as long as the caller's own guard, if any, is held.
+///
+template<class V, class MA = MemAlloc>
+class SkipListHashtable : public StringHashtable<V> {
+ public:
+  typedef typename StringHashtable<V>::KVPair KVPair;
+
+  SkipListHashtable();
+  ~SkipListHashtable();
+
+  V Get(const char *key) const; ///< Returns NULL if the key is not found
+  bool Insert(const char *key, V value);
+  V Update(const char *key, V value);
+  V Remove(const char *key);
+  std::vector<KVPair> Entries(const char *key = NULL, std::size_t n = -1) const;
+  std::size_t Size() const { return size_.load(std::memory_order_relaxed); }
+
+ private:
+  static const int kMaxLevel = 24; // enough for 4^24 keys at p = 1/4
+
+  struct Node {
+    String key;
+    std::atomic<V> value;
+    int top; ///< Number of levels the node is linked in
+    std::atomic<bool> marked;       ///< Logically removed
+    std::atomic<bool> fully_linked; ///< Linked in all of its levels
+    std::atomic_flag lock;
+    std::atomic<Node *> next[1];    ///< Really next[top]
+
+    void Lock() { while (lock.test_and_set(std::memory_order_acquire)) { } }
+    void Unlock() { lock.clear(std::memory_order_release); }
+    bool Visible() const {
+      return fully_linked.load(std::memory_order_acquire) &&
+          !marked.load(std::memory_order_acquire);
+    }
+  };
+
+  static Node *NewNode(const String &key, V value, int top);
+  static void DeleteNode(Node *node);
+  static void FreeNode(void *node, void *) {
+    String::Free<MA>(((Node *)node)->key);
+    DeleteNode((Node *)node);
+  }
+  static int Compare(const Node *node, const char *key) {
+    return strcmp(node->key.value(), key);
+  }
+  static int RandomLevel();
+  static void UnlockAll(Node **locked, int n);
+
+  int Find(const char *key, Node **preds, Node **succs) const;
+  Node *LowerBound(const char *key) const;
+
+  Node *head_;
+  std::atomic<std::size_t> size_;
+};
+
+template<class V, class MA>
+SkipListHashtable<V, MA>::SkipListHashtable() : size_(0) {
+  head_ = NewNode(String(), NULL, kMaxLevel);
+  head_->fully_linked.store(true, std::memory_order_relaxed);
+}
+
+template<class V, class MA>
+SkipListHashtable<V, MA>::~SkipListHashtable() {
+  Node *node = head_->next[0].load(std::memory_order_relaxed);
+  while (node) {
+    Node *next = node->next[0].load(std::memory_order_relaxed);
+    FreeNode(node, NULL);
+    node = next;
+  }
+  DeleteNode(head_);
+}
+
+template<class V, class MA>
+typename SkipListHashtable<V, MA>::Node *SkipListHashtable<V, MA>::NewNode(
+    const String &key, V value, int top) {
+  std::size_t size = sizeof(Node) + (top - 1) * sizeof(std::atomic<Node *>);
+  Node *node = new (MA::Malloc(size)) Node;
+  node->key = key;
+  node->value.store(value, std::memory_order_relaxed);
+  node->top = top;
+  node->marked.store(false, std::memory_order_relaxed);
+  node->fully_linked.store(false, std::memory_order_relaxed);
+  node->lock.clear();
+  for (int level = 0; level < top; ++level) {
+    new (&node->next[level]) std::atomic<Node *>(nullptr);
+  }
+  return node;
+}
+
+template<class V, class MA>
+void SkipListHashtable<V, MA>::DeleteNode(Node *node) {
+  std::size_t size = sizeof(Node) + (node->top - 1) * sizeof(std::atomic<Node *>);
+  node->~Node();
+  MA::Free(node, size);
+}
+
+template<class V, class MA>
+int SkipListHashtable<V, MA>::RandomLevel() {
+  static std::atomic<uint64_t> seed(0x9e3779b97f4a7c15ULL);
+  thread_local uint64_t state = seed.fetch_add(0x9e3779b97f4a7c15ULL);
+  state ^= state << 13;
+  state ^= state >> 7;
+  state ^= state << 17;
+  uint64_t bits = state;
+  int top = 1;
+  while (top < kMaxLevel && (bits & 3) == 0) {
+    ++top;
+    bits >>= 2;
+  }
+  return top;
+}
+
+template<class V, class MA>
+void SkipListHashtable<V, MA>::UnlockAll(Node **locked, int n) {
+  for (int i = 0; i < n; ++i) {
+    locked[i]->Unlock();
+  }
+}
+
+//
+// Fills preds and succs with the nodes around key on every level, and returns
+// the highest level key was found on, or -1.
+//
+template<class V, class MA>
+int SkipListHashtable<V, MA>::Find(const char *key, Node **preds,
+                               Node **succs) const {
+  int found = -1;
+  Node *pred = head_;
+  for (int level = kMaxLevel - 1; level >= 0; --level) {
+    Node *curr = pred->next[level].load(std::memory_order_acquire);
+    while (curr && Compare(curr, key) < 0) {
+      pred = curr;
+      curr = pred->next[level].load(std::memory_order_acquire);
+    }
+    if (found == -1 && curr && Compare(curr, key) == 0) {
+      found = level;
+    }
+    preds[level] = pred;
+    succs[level] = curr;
+  }
+  return found;
+}
+
+//
+// Returns the first node on the bottom level whose key is not less than key.
+//
+template<class V, class MA>
+typename SkipListHashtable<V, MA>::Node *SkipListHashtable<V, MA>::LowerBound(
+    const char *key) const {
+  Node *pred = head_;
+  Node *curr = NULL;
+  for (int level = kMaxLevel - 1; level >= 0; --level) {
+    curr = pred->next[level].load(std::memory_order_acquire);
+    while (curr && Compare(curr, key) < 0) {
+      pred = curr;
+      curr = pred->next[level].load(std::memory_order_acquire);
+    }
+  }
+  return curr;
+}
+
+template<class V, class MA>
+V SkipListHashtable<V, MA>::Get(const char *key) const {
+  EpochGuard guard;
+  Node *node = LowerBound(key);
+  if (!node || Compare(node, key) != 0 || !node->Visible()) return NULL;
+  return node->value.load(std::memory_order_acquire);
+}
+
+template<class V, class MA>
+bool SkipListHashtable<V, MA>::Insert(const char *key, V value) {
+  if (!key) return false;
+  EpochGuard guard;
+  int top = RandomLevel();
+  Node *preds[kMaxLevel], *succs[kMaxLevel];
+  while (true) {
+    int found = Find(key, preds, succs);
+    if (found != -1) {
+      Node *node = succs[found];
+      if (!node->marked.load(std::memory_order_acquire)) {
+        while (!node->fully_linked.load(std::memory_order_acquire)) { }
+        return false;
+      }
+      continue; // being removed; retry once it is unlinked
+    }
+
+    // Lock the predecessors bottom-up, i.e. in decreasing key order
+    Node *locked[kMaxLevel];
+    int num_locked = 0;
+    bool valid = true;
+    for (int level = 0; valid && level < top; ++level) {
+      Node *pred = preds[level];
+      Node *succ = succs[level];
+      if (!num_locked || locked[num_locked - 1] != pred) {
+        pred->Lock();
+        locked[num_locked++] = pred;
+      }
+      valid = !pred->marked.load(std::memory_order_acquire) &&
+          (!succ || !succ->marked.load(std::memory_order_acquire)) &&
+          pred->next[level].load(std::memory_order_acquire) == succ;
+    }
+    if (!valid) {
+      UnlockAll(locked, num_locked);
+      continue;
+    }
+
+    Node *node = NewNode(String::Copy<MA>(key), value, top);
+    for (int level = 0; level < top; ++level) {
+      node->next[level].store(succs[level], std::memory_order_relaxed);
+    }
+    for (int level = 0; level < top; ++level) {
+      preds[level]->next[level].store(node, std::memory_order_release);
+    }
+    node->fully_linked.store(true, std::memory_order_release);
+    UnlockAll(locked, num_locked);
+    size_.fetch_add(1, std::memory_order_relaxed);
+    return true;
+  }
+}
+
+template<class V, class MA>
+V SkipListHashtable<V, MA>::Update(const char *key, V value) {
+  EpochGuard guard;
+  Node *node = LowerBound(key);
+  if (!node || Compare(node, key) != 0) return NULL;
+  while (!node->fully_linked.load(std::memory_order_acquire)) { }
+  node->Lock();
+  V old(NULL);
+  if (!node->marked.load(std::memory_order_relaxed)) {
+    old = node->value.exchange(value, std::memory_order_acq_rel);
+  }
+  node->Unlock();
+  return old;
+}
+
+template<class V, class MA>
+V SkipListHashtable<V, MA>::Remove(const char *key) {
+  EpochGuard guard;
+  Node *preds[kMaxLevel], *succs[kMaxLevel];
+  Node *victim = NULL;
+  bool is_marked = false;
+  while (true) {
+    int found = Find(key, preds, succs);
+    if (!is_marked) {
+      if (found == -1) return NULL;
+      victim = succs[found];
+      if (!victim->fully_linked.load(std::memory_order_acquire) ||
+          victim->top != found + 1 ||
+          victim->marked.load(std::memory_order_acquire)) {
+        return NULL;
+      }
+      victim->Lock();
+      if (victim->marked.load(std::memory_order_relaxed)) {
+        victim->Unlock();
+        return NULL;
+      }
+      victim->marked.store(true, std::memory_order_release);
+      is_marked = true;
+    }
+
+    Node *locked[kMaxLevel];
+    int num_locked = 0;
+    bool valid = true;
+    for (int level = 0; valid && level < victim->top; ++level) {
+      Node *pred = preds[level];
+      if (!num_locked || locked[num_locked - 1] != pred) {
+        pred->Lock();
+        locked[num_locked++] = pred;
+      }
+      valid = !pred->marked.load(std::memory_order_acquire) &&
+          pred->next[level].load(std::memory_order_acquire) == victim;
+    }
+    if (!valid) {
+      UnlockAll(locked, num_locked);
+      continue;
+    }
+
+    for (int level = victim->top - 1; level >= 0; --level) {
+      preds[level]->next[level].store(
+          victim->next[level].load(std::memory_order_relaxed),
+          std::memory_order_release);
+    }
+    V old = victim->value.load(std::memory_order_relaxed);
+    victim->Unlock();
+    UnlockAll(locked, num_locked);
+    size_.fetch_sub(1, std::memory_order_relaxed);
+    Epoch::Retire(victim, &FreeNode);
+    return old;
+  }
+}
+
+template<class V, class MA>
+std::vector<typename SkipListHashtable<V, MA>::KVPair>
+SkipListHashtable<V, MA>::Entries(const char *key, std::size_t n) const {
+  EpochGuard guard;
+  std::vector<KVPair> pairs;
+  Node *node = key ? LowerBound(key) :
+      head_->next[0].load(std::memory_order_acquire);
+  for (; node && pairs.size() < n;
+       node = node->next[0].load(std::memory_order_acquire)) {
+    if (!node->Visible()) continue;
+    pairs.push_back(std::make_pair(node->key.value(),
+        node->value.load(std::memory_order_acquire)));
+  }
+  return pairs;
+}
+
+} // vmp
+
+#endif // YCSB_C_LIB_SKIPLIST_HASHTABLE_H_
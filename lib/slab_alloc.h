@@ -0,0 +1,227 @@
+//
+// slab_alloc.h
+//
+// A slab allocator with the same interface as MemAlloc, for the many small,
+// similarly sized keys and values of the in-memory engines.
+//
+
+#ifndef YCSB_C_LIB_SLAB_ALLOC_H_
+#define YCSB_C_LIB_SLAB_ALLOC_H_
+
+#include <atomic>
+#include <cstdint>
+#include <cstdlib>
+#include <mutex>
+#include <new>
+#include <sys/mman.h>
+
+namespace vmp {
+
+///
+/// Sizes up to kMaxSize are rounded up to one of kClasses size classes, and
+/// larger ones go to malloc(). Each thread keeps a free list per class and
+/// carves new objects out of its own kRegionSize region, so the common path
+/// takes no lock. A thread whose free list grows past kCacheLimit hands a
+/// batch to a shared list for its class, where other threads refill from;
+/// so do threads that exit. Regions are never returned to the system.
+///
+/// With set_huge_pages(true), before the first allocation, regions are
+/// backed by huge pages: explicit ones (MAP_HUGETLB) if any are reserved,
+/// else transparent ones (MADV_HUGEPAGE).
+///
+class SlabAlloc {
+ public:
+  static void *Malloc(std::size_t size);
+
+  template <typename T>
+  static void Free(T *p, std::size_t size) { Release((void *)p, size); }
+
+  template <typename T, typename... Arguments>
+  static T *New(Arguments... args) {
+    static_assert(alignof(T) <= kAlign, "SlabAlloc aligns to 16 bytes");
+    return new (Malloc(sizeof(T))) T(args...);
+  }
+
+  template <typename T>
+  static void Delete(T *p) {
+    p->~T();
+    Release(p, sizeof(T));
+  }
+
+  static void set_huge_pages(bool huge) { huge_pages_.store(huge); }
+  static std::size_t mapped_bytes() { return mapped_bytes_.load(); }
+
+ private:
+  static const std::size_t kAlign = 16;
+  static const std::size_t kMaxSize = 4096;
+  static const int kClasses = 40; // 16 B steps to 256, 64 B to 1 KB, 256 B to 4 KB
+  static const std::size_t kRegionSize = 2 << 20;
+  static const uint32_t kCacheLimit = 1024;
+  static const uint32_t kBatch = 256;
+
+  struct FreeObject {
+    FreeObject *next;
+  };
+
+  struct ThreadCache {
+    FreeObject *free_list[kClasses];
+    uint32_t count[kClasses];
+    char *next; ///< Uncarved part of the current region
+    char *end;
+
+    ThreadCache();
+    ~ThreadCache();
+  };
+
+  struct alignas(64) SharedList {
+    std::mutex mutex;
+    FreeObject *free_list;
+    SharedList() : free_list(NULL) { }
+  };
+
+  static int SizeClass(std::size_t size);
+  static std::size_t ClassSize(int c);
+  static void Release(void *p, std::size_t size);
+  static void *Refill(ThreadCache &cache, int c);
+  static void Spill(ThreadCache &cache, int c, uint32_t n);
+  static char *MapRegion();
+
+  static ThreadCache &Cache() {
+    thread_local ThreadCache cache;
+    return cache;
+  }
+
+  inline static std::atomic<bool> huge_pages_{false};
+  inline static std::atomic<std::size_t> mapped_bytes_{0};
+  inline static SharedList shared_[kClasses];
+};
+
+inline int SlabAlloc::SizeClass(std::size_t size) {
+  if (size <= 256) return size ? (size - 1) / 16 : 0;
+  if (size <= 1024) return 16 + (size - 257) / 64;
+  return 28 + (size - 1025) / 256;
+}
+
+inline std::size_t SlabAlloc::ClassSize(int c) {
+  if (c < 16) return (c + 1) * 16;
+  if (c < 28) return 256 + (c - 15) * 64;
+  return 1024 + (c - 27) * 256;
+}
+
+inline void *SlabAlloc::Malloc(std::size_t size) {
+  if (size > kMaxSize) return malloc(size);
+  int c = SizeClass(size);
+  ThreadCache &cache = Cache();
+  FreeObject *object = cache.free_list[c];
+  if (!object) return Refill(cache, c);
+  cache.free_list[c] = object->next;
+  --cache.count[c];
+  return object;
+}
+
+inline void SlabAlloc::Release(void *p, std::size_t size) {
+  if (!p) return;
+  if (size > kMaxSize) {
+    free(p);
+    return;
+  }
+  int c = SizeClass(size);
+  ThreadCache &cache = Cache();
+  FreeObject *object = (FreeObject *)p;
+  object->next = cache.free_list[c];
+  cache.free_list[c] = object;
+  if (++cache.count[c] > kCacheLimit) {
+    Spill(cache, c, kBatch);
+  }
+}
+
+//
+// Takes a batch of free objects from the shared list, or else carves a new
+// object out of the thread's region.
+//
+inline void *SlabAlloc::Refill(ThreadCache &cache, int c) {
+  SharedList &shared = shared_[c];
+  {
+    std::lock_guard<std::mutex> lock(shared.mutex);
+    for (uint32_t i = 0; i < kBatch && shared.free_list; ++i) {
+      FreeObject *object = shared.free_list;
+      shared.free_list = object->next;
+      object->next = cache.free_list[c];
+      cache.free_list[c] = object;
+      ++cache.count[c];
+    }
+  }
+  if (cache.free_list[c]) return Malloc(ClassSize(c));
+
+  std::size_t size = ClassSize(c);
+  if ((std::size_t)(cache.end - cache.next) < size) {
+    cache.next = MapRegion();
+    cache.end = cache.next + kRegionSize;
+  }
+  void *object = cache.next;
+  cache.next += size;
+  return object;
+}
+
+//
+// Moves n objects from the thread's free list for class c to the shared one.
+//
+inline void SlabAlloc::Spill(ThreadCache &cache, int c, uint32_t n) {
+  if (!n) return;
+  FreeObject *first = cache.free_list[c];
+  FreeObject *last = first;
+  for (uint32_t i = 1; i < n; ++i) {
+    last = last->next;
+  }
+  cache.free_list[c] = last->next;
+  cache.count[c] -= n;
+
+  SharedList &shared = shared_[c];
+  std::lock_guard<std::mutex> lock(shared.mutex);
+  last->next = shared.free_list;
+  shared.free_list = first;
+}
+
+inline char *SlabAlloc::MapRegion() {
+  void *region = MAP_FAILED;
+  if (huge_pages_.load(std::memory_order_relaxed)) {
+    region = mmap(NULL, kRegionSize, PROT_READ | PROT_WRITE,
+                  MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+  }
+  if (region == MAP_FAILED) {
+    // Map twice the size and trim it to a huge-page aligned region, so that
+    // transparent huge pages can back it whole
+    char *mapped = (char *)mmap(NULL, 2 * kRegionSize, PROT_READ | PROT_WRITE,
+                                MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (mapped == MAP_FAILED) throw std::bad_alloc();
+    char *aligned = (char *)(((uintptr_t)mapped + kRegionSize - 1) &
+                             ~(uintptr_t)(kRegionSize - 1));
+    if (aligned != mapped) munmap(mapped, aligned - mapped);
+    munmap(aligned + kRegionSize, mapped + kRegionSize - aligned);
+    region = aligned;
+#ifdef MADV_HUGEPAGE
+    if (huge_pages_.load(std::memory_order_relaxed)) {
+      madvise(region, kRegionSize, MADV_HUGEPAGE);
+    }
+#endif
+  }
+  mapped_bytes_.fetch_add(kRegionSize, std::memory_order_relaxed);
+  return (char *)region;
+}
+
+inline SlabAlloc::ThreadCache::ThreadCache() : next(NULL), end(NULL) {
+  for (int c = 0; c < kClasses; ++c) {
+    free_list[c] = NULL;
+    count[c] = 0;
+  }
+}
+
+inline SlabAlloc::ThreadCache::~ThreadCache() {
+  for (int c = 0; c < kClasses; ++c) {
+    Spill(*this, c, count[c]);
+  }
+}
+
+} // vmp
+
+#endif // YCSB_C_LIB_SLAB_ALLOC_H_
@@ -0,0 +1,454 @@
+//
+// swiss_hashtable.h
+//
+// A concurrent open-addressing StringHashtable in the style of Abseil's Swiss
+// tables: slots come in groups of 16 with one control byte each, and a probe
+// compares a 7-bit hash tag against a whole group's control bytes at once
+// with SSE2.
+//
+
+#ifndef YCSB_C_LIB_SWISS_HASHTABLE_H_
+#define YCSB_C_LIB_SWISS_HASHTABLE_H_
+
+#include "lib/string_hashtable.h"
+
+#include <atomic>
+#include <cstdint>
+#include <mutex>
+#include <vector>
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+#include "lib/epoch.h"
+#include "lib/string.h"
+
+namespace vmp {
+
+///
+/// The table is split into segments by the top bits of the hash, each an
+/// independent Swiss table with its own write lock, so writers only contend
+/// on the same segment.
+///
+/// Readers take no locks: every group has a version that writers make odd
+/// while they change it, and a reader retries a group whose version was odd
+/// or changed while it looked. A segment that grows gets a new array of
+/// groups and leaves the old one untouched for readers still probing it.
+/// Every operation runs inside a vmp::EpochGuard, and old arrays and the
+/// keys of removed entries are retired to vmp::Epoch.
+///
+/// Entries() walks segments and groups in memory order; it is not sorted.
+///
+template<class V, class MA = MemAlloc>
+class SwissHashtable : public StringHashtable<V> {
+ public:
+  typedef typename StringHashtable<V>::KVPair KVPair;
+
+  ///
+  /// segments is rounded up to a power of two; small tables, such as the
+  /// fields of one record, want just one.
+  ///
+  SwissHashtable(std::size_t segments = 1);
+  ~SwissHashtable();
+
+  V Get(const char *key) const; ///< Returns NULL if the key is not found
+  bool Insert(const char *key, V value);
+  V Update(const char *key, V value);
+  V Remove(const char *key);
+  std::vector<KVPair> Entries(const char *key = NULL, std::size_t n = -1) const;
+  std::size_t Size() const;
+
+ private:
+  static const int kGroupSize = 16;
+  static const uint8_t kEmpty = 0x80;
+  static const uint8_t kDeleted = 0xFE; // tags are 0x00 to 0x7F
+
+  struct Slot {
+    std::atomic<const char *> key;
+    std::atomic<V> value;
+  };
+
+  struct alignas(16) Group {
+    uint8_t ctrl[kGroupSize];
+    std::atomic<uint32_t> version;
+    Slot slots[kGroupSize];
+
+    Group();
+    uint32_t Match(uint8_t tag) const;
+    uint32_t MatchEmpty() const { return Match(kEmpty); }
+    uint32_t MatchFree() const; ///< Empty or deleted
+    void BeginWrite();
+    void EndWrite();
+  };
+
+  struct Table {
+    std::size_t mask; ///< Number of groups minus one
+    Group *groups;
+    std::size_t capacity() const { return (mask + 1) * kGroupSize; }
+  };
+
+  struct alignas(64) Segment {
+    std::mutex mutex;
+    std::atomic<Table *> table;
+    std::size_t used; ///< Slots not empty, i.e. live or deleted
+    std::atomic<std::size_t> live;
+  };
+
+  static uint64_t Hash(const char *key);
+  static uint8_t Tag(uint64_t hash) { return hash & 0x7F; }
+  static Table *NewTable(std::size_t groups);
+  static void DeleteTable(Table *table);
+  static void FreeTable(void *table, void *) { DeleteTable((Table *)table); }
+  static void FreeKey(void *key, void *) {
+    String::Free<MA>(String::Wrap((const char *)key));
+  }
+
+  Segment &SegmentOf(uint64_t hash) const {
+    return segments_[(hash >> 32) & (num_segments_ - 1)];
+  }
+  Slot *FindLocked(Table *table, uint64_t hash, const char *key,
+                   Group **group, Slot **free) const;
+  void Grow(Segment &segment);
+
+  std::size_t num_segments_;
+  Segment *segments_;
+};
+
+//
+// Group
+//
+template<class V, class MA>
+SwissHashtable<V, MA>::Group::Group() : version(0) {
+  memset(ctrl, kEmpty, kGroupSize);
+  for (Slot &slot : slots) {
+    slot.key.store(NULL, std::memory_order_relaxed);
+    slot.value.store(NULL, std::memory_order_relaxed);
+  }
+}
+
+template<class V, class MA>
+inline uint32_t SwissHashtable<V, MA>::Group::Match(uint8_t tag) const {
+#ifdef __SSE2__
+  __m128i bytes = _mm_load_si128((const __m128i *)ctrl);
+  return _mm_movemask_epi8(_mm_cmpeq_epi8(bytes, _mm_set1_epi8((char)tag)));
+#else
+  uint32_t mask = 0;
+  for (int i = 0; i < kGroupSize; ++i) {
+    if (ctrl[i] == tag) mask |= 1u << i;
+  }
+  return mask;
+#endif
+}
+
+template<class V, class MA>
+inline uint32_t SwissHashtable<V, MA>::Group::MatchFree() const {
+#ifdef __SSE2__
+  return _mm_movemask_epi8(_mm_load_si128((const __m128i *)ctrl));
+#else
+  uint32_t mask = 0;
+  for (int i = 0; i < kGroupSize; ++i) {
+    if (ctrl[i] & 0x80) mask |= 1u << i;
+  }
+  return mask;
+#endif
+}
+
+template<class V, class MA>
+inline void SwissHashtable<V, MA>::Group::BeginWrite() {
+  version.store(version.load(std::memory_order_relaxed) + 1,
+                std::memory_order_relaxed);
+  std::atomic_thread_fence(std::memory_order_release);
+}
+
+template<class V, class MA>
+inline void SwissHashtable<V, MA>::Group::EndWrite() {
+  version.store(version.load(std::memory_order_relaxed) + 1,
+                std::memory_order_release);
+}
+
+//
+// SwissHashtable
+//
+template<class V, class MA>
+SwissHashtable<V, MA>::SwissHashtable(std::size_t segments) : num_segments_(1) {
+  while (num_segments_ < segments) num_segments_ <<= 1;
+  segments_ = new Segment[num_segments_];
+  for (std::size_t i = 0; i < num_segments_; ++i) {
+    segments_[i].table.store(NewTable(1), std::memory_order_relaxed);
+    segments_[i].used = 0;
+    segments_[i].live.store(0, std::memory_order_relaxed);
+  }
+}
+
+template<class V, class MA>
+SwissHashtable<V, MA>::~SwissHashtable() {
+  for (std::size_t i = 0; i < num_segments_; ++i) {
+    Segment &segment = segments_[i];
+    Table *table = segment.table.load(std::memory_order_relaxed);
+    for (std::size_t g = 0; g <= table->mask; ++g) {
+      for (Slot &slot : table->groups[g].slots) {
+        const char *key = slot.key.load(std::memory_order_relaxed);
+        if (key) FreeKey((void *)key, NULL);
+      }
+    }
+    DeleteTable(table);
+  }
+  delete[] segments_;
+}
+
+//
+// SDBM (as in String) mixes its low bits poorly, which the tags and group
+// indexes are taken from, so it is finished with MurmurHash3's fmix64.
+//
+template<class V, class MA>
+inline uint64_t SwissHashtable<V, MA>::Hash(const char *key) {
+  uint64_t hash = String::Wrap(key).hash();
+  hash ^= hash >> 33;
+  hash *= 0xff51afd7ed558ccdULL;
+  hash ^= hash >> 33;
+  hash *= 0xc4ceb9fe1a85ec53ULL;
+  hash ^= hash >> 33;
+  return hash;
+}
+
+template<class V, class MA>
+typename SwissHashtable<V, MA>::Table *SwissHashtable<V, MA>::NewTable(
+    std::size_t groups) {
+  Table *table = new Table;
+  table->mask = groups - 1;
+  table->groups = new Group[groups];
+  return table;
+}
+
+template<class V, class MA>
+void SwissHashtable<V, MA>::DeleteTable(Table *table) {
+  delete[] table->groups;
+  delete table;
+}
+
+//
+// Probes for key with the segment lock held. Returns its slot, or NULL and
+// sets free to the first empty or deleted slot on the probe sequence.
+//
+template<class V, class MA>
+typename SwissHashtable<V, MA>::Slot *SwissHashtable<V, MA>::FindLocked(
+    Table *table, uint64_t hash, const char *key,
+    Group **group, Slot **free) const {
+  *free = NULL;
+  std::size_t g = (hash >> 7) & table->mask;
+  for (std::size_t step = 1; ; ++step) {
+    Group &probe = table->groups[g];
+    for (uint32_t match = probe.Match(Tag(hash)); match; match &= match - 1) {
+      Slot &slot = probe.slots[__builtin_ctz(match)];
+      if (strcmp(slot.key.load(std::memory_order_relaxed), key) == 0) {
+        *group = &probe;
+        return &slot;
+      }
+    }
+    uint32_t free_mask = probe.MatchFree();
+    if (free_mask && !*free) {
+      *group = &probe;
+      *free = &probe.slots[__builtin_ctz(free_mask)];
+    }
+    if (probe.MatchEmpty() || step > table->mask) return NULL;
+    g = (g + step) & table->mask;
+  }
+}
+
+//
+// Moves a segment's live entries to a new array of groups, twice as big as
+// they need at most 7/8 occupancy, and retires the old one.
+//
+template<class V, class MA>
+void SwissHashtable<V, MA>::Grow(Segment &segment) {
+  Table *old = segment.table.load(std::memory_order_relaxed);
+  std::size_t live = segment.live.load(std::memory_order_relaxed);
+  std::size_t groups = 1;
+  while (groups * kGroupSize * 7 / 8 < (live + 1) * 2) groups <<= 1;
+
+  Table *table = NewTable(groups);
+  for (std::size_t g = 0; g <= old->mask; ++g) {
+    Group &from = old->groups[g];
+    for (int i = 0; i < kGroupSize; ++i) {
+      if (from.ctrl[i] & 0x80) continue;
+      const char *key = from.slots[i].key.load(std::memory_order_relaxed);
+      uint64_t hash = Hash(key);
+      std::size_t to = (hash >> 7) & table->mask;
+      for (std::size_t step = 1; !table->groups[to].MatchEmpty(); ++step) {
+        to = (to + step) & table->mask;
+      }
+      Group &into = table->groups[to];
+      int slot = __builtin_ctz(into.MatchEmpty());
+      into.ctrl[slot] = Tag(hash);
+      into.slots[slot].key.store(key, std::memory_order_relaxed);
+      into.slots[slot].value.store(
+          from.slots[i].value.load(std::memory_order_relaxed),
+          std::memory_order_relaxed);
+    }
+  }
+  segment.used = live;
+  segment.table.store(table, std::memory_order_release);
+  Epoch::Retire(old, &FreeTable);
+}
+
+template<class V, class MA>
+V SwissHashtable<V, MA>::Get(const char *key) const {
+  EpochGuard guard;
+  uint64_t hash = Hash(key);
+  const Table *table = SegmentOf(hash).table.load(std::memory_order_acquire);
+  std::size_t g = (hash >> 7) & table->mask;
+  for (std::size_t step = 1; ; ) {
+    const Group &group = table->groups[g];
+    uint32_t version = group.version.load(std::memory_order_acquire);
+    if (version & 1) continue;
+
+    V value(NULL);
+    bool found = false;
+    for (uint32_t match = group.Match(Tag(hash)); match; match &= match - 1) {
+      const Slot &slot = group.slots[__builtin_ctz(match)];
+      const char *slot_key = slot.key.load(std::memory_order_acquire);
+      if (slot_key && strcmp(slot_key, key) == 0) {
+        value = slot.value.load(std::memory_order_acquire);
+        found = true;
+        break;
+      }
+    }
+    bool end = group.MatchEmpty() || step > table->mask;
+
+    std::atomic_thread_fence(std::memory_order_acquire);
+    if (group.version.load(std::memory_order_relaxed) != version) continue;
+    if (found) return value;
+    if (end) return NULL;
+    g = (g + step) & table->mask;
+    ++step;
+  }
+}
+
+template<class V, class MA>
+bool SwissHashtable<V, MA>::Insert(const char *key, V value) {
+  if (!key) return false;
+  EpochGuard guard;
+  uint64_t hash = Hash(key);
+  Segment &segment = SegmentOf(hash);
+  std::lock_guard<std::mutex> lock(segment.mutex);
+
+  Table *table = segment.table.load(std::memory_order_relaxed);
+  Group *group;
+  Slot *slot;
+  if (FindLocked(table, hash, key, &group, &slot)) return false;
+
+  bool reuse = slot && group->ctrl[slot - group->slots] == kDeleted;
+  if (!reuse && (segment.used + 1) * 8 > table->capacity() * 7) {
+    Grow(segment);
+    table = segment.table.load(std::memory_order_relaxed);
+    FindLocked(table, hash, key, &group, &slot);
+  }
+  int index = slot - group->slots;
+
+  group->BeginWrite();
+  slot->key.store(String::Copy<MA>(key).value(),
+                  std::memory_order_relaxed);
+  slot->value.store(value, std::memory_order_relaxed);
+  group->ctrl[index] = Tag(hash);
+  group->EndWrite();
+
+  if (!reuse) ++segment.used;
+  segment.live.fetch_add(1, std::memory_order_relaxed);
+  return true;
+}
+
+template<class V, class MA>
+V SwissHashtable<V, MA>::Update(const char *key, V value) {
+  EpochGuard guard;
+  uint64_t hash = Hash(key);
+  Segment &segment = SegmentOf(hash);
+  std::lock_guard<std::mutex> lock(segment.mutex);
+
+  Group *group;
+  Slot *free;
+  Slot *slot = FindLocked(segment.table.load(std::memory_order_relaxed),
+                          hash, key, &group, &free);
+  if (!slot) return NULL;
+  return slot->value.exchange(value, std::memory_order_acq_rel);
+}
+
+template<class V, class MA>
+V SwissHashtable<V, MA>::Remove(const char *key) {
+  EpochGuard guard;
+  uint64_t hash = Hash(key);
+  Segment &segment = SegmentOf(hash);
+  std::lock_guard<std::mutex> lock(segment.mutex);
+
+  Group *group;
+  Slot *free;
+  Slot *slot = FindLocked(segment.table.load(std::memory_order_relaxed),
+                          hash, key, &group, &free);
+  if (!slot) return NULL;
+
+  // No probe goes on past a group with an empty slot, so in such a group the
+  // removed slot can be made empty again rather than deleted
+  bool empty = group->MatchEmpty();
+  V old = slot->value.load(std::memory_order_relaxed);
+  const char *old_key = slot->key.load(std::memory_order_relaxed);
+
+  group->BeginWrite();
+  group->ctrl[slot - group->slots] = empty ? kEmpty : kDeleted;
+  slot->key.store(NULL, std::memory_order_relaxed);
+  slot->value.store(NULL, std::memory_order_relaxed);
+  group->EndWrite();
+
+  Epoch::Retire((void *)old_key, &FreeKey);
+  if (empty) --segment.used;
+  segment.live.fetch_sub(1, std::memory_order_relaxed);
+  return old;
+}
+
+template<class V, class MA>
+std::vector<typename SwissHashtable<V, MA>::KVPair> SwissHashtable<V, MA>::Entries(
+    const char *key, std::size_t n) const {
+  EpochGuard guard;
+  std::vector<KVPair> pairs;
+  std::size_t start = 0;
+  if (key) {
+    if (!Get(key)) return pairs;
+    start = &SegmentOf(Hash(key)) - segments_;
+  }
+  bool started = !key;
+  for (std::size_t s = start; s < num_segments_ && pairs.size() < n; ++s) {
+    const Table *table = segments_[s].table.load(std::memory_order_acquire);
+    for (std::size_t g = 0; g <= table->mask && pairs.size() < n; ++g) {
+      const Group &group = table->groups[g];
+      std::size_t size = pairs.size();
+      bool was_started = started;
+      uint32_t version;
+      do {
+        pairs.resize(size);
+        started = was_started;
+        while ((version = group.version.load(std::memory_order_acquire)) & 1) { }
+        for (int i = 0; i < kGroupSize && pairs.size() < n; ++i) {
+          const char *slot_key = group.slots[i].key.load(
+              std::memory_order_acquire);
+          if (!slot_key) continue;
+          if (!started && strcmp(slot_key, key) != 0) continue;
+          started = true;
+          pairs.push_back(std::make_pair(slot_key,
+              group.slots[i].value.load(std::memory_order_acquire)));
+        }
+        std::atomic_thread_fence(std::memory_order_acquire);
+      } while (group.version.load(std::memory_order_relaxed) != version);
+    }
+  }
+  return pairs;
+}
+
+template<class V, class MA>
+std::size_t SwissHashtable<V, MA>::Size() const {
+  std::size_t size = 0;
+  for (std::size_t i = 0; i < num_segments_; ++i) {
+    size += segments_[i].live.load(std::memory_order_relaxed);
+  }
+  return size;
+}
+
+} // vmp
+
+#endif // YCSB_C_LIB_SWISS_HASHTABLE_H_
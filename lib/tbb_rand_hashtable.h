@@ -17,7 +17,7 @@
 
 namespace vmp {
 
-template<class V>
+template<class V, class MA = MemAlloc>
 class TbbRandHashtable : public StringHashtable<V> {
  public:
   typedef typename StringHashtable<V>::KVPair KVPair;
@@ -41,24 +41,24 @@ class TbbRandHashtable : public StringHashtable<V> {
   mutable tbb::queuing_rw_mutex mutex_;
 };
 
-template<class V>
-V TbbRandHashtable<V>::Get(const char *key) const {
+template<class V, class MA>
+V TbbRandHashtable<V, MA>::Get(const char *key) const {
   typename Hashtable::accessor result;
   tbb::queuing_rw_mutex::scoped_lock lock(mutex_, false);
   if (!table_.find(result, String::Wrap(key))) return NULL;
   return result->second;
 }
 
-template<class V>
-bool TbbRandHashtable<V>::Insert(const char *key, V value) {
+template<class V, class MA>
+bool TbbRandHashtable<V, MA>::Insert(const char *key, V value) {
   if (!key) return false;
-  String skey = String::Copy<MemAlloc>(key);
+  String skey = String::Copy<MA>(key);
   tbb::queuing_rw_mutex::scoped_lock lock(mutex_, false);
   return table_.insert(std::make_pair(skey, value));
 }
 
-template<class V>
-V TbbRandHashtable<V>::Update(const char *key, V value) {
+template<class V, class MA>
+V TbbRandHashtable<V, MA>::Update(const char *key, V value) {
   typename Hashtable::accessor result;
   V old(NULL);
   tbb::queuing_rw_mutex::scoped_lock lock(mutex_, false);
@@ -69,21 +69,21 @@ V TbbRandHashtable<V>::Update(const char *key, V value) {
   return old;
 }
 
-template<class V>
-V TbbRandHashtable<V>::Remove(const char *key) {
+template<class V, class MA>
+V TbbRandHashtable<V, MA>::Remove(const char *key) {
   typename Hashtable::accessor result;
   V old(NULL);
   tbb::queuing_rw_mutex::scoped_lock lock(mutex_, false);
   if (table_.find(result, String::Wrap(key))) {
-    String::Free<MemAlloc>(result->first);
+    String::Free<MA>(result->first);
     old = result->second;
     table_.erase(result);
   }
   return old;
 }
 
-template<class V>
-std::vector<typename TbbRandHashtable<V>::KVPair> TbbRandHashtable<V>::Entries(
+template<class V, class MA>
+std::vector<typename TbbRandHashtable<V, MA>::KVPair> TbbRandHashtable<V, MA>::Entries(
     const char *key, std::size_t n) const {
   std::vector<KVPair> pairs;
   typename Hashtable::const_iterator pos;
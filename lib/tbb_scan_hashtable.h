@@ -17,7 +17,7 @@
 
 namespace vmp {
 
-template<class V>
+template<class V, class MA = MemAlloc>
 class TbbScanHashtable : public StringHashtable<V> {
  public:
   typedef typename StringHashtable<V>::KVPair KVPair;
@@ -41,24 +41,24 @@ class TbbScanHashtable : public StringHashtable<V> {
   mutable tbb::queuing_rw_mutex mutex_;
 };
 
-template<class V>
-V TbbScanHashtable<V>::Get(const char *key) const {
+template<class V, class MA>
+V TbbScanHashtable<V, MA>::Get(const char *key) const {
   tbb::queuing_rw_mutex::scoped_lock lock(mutex_, false);
   typename Hashtable::const_iterator it = table_.find(String::Wrap(key));
   if (it == table_.end()) return NULL;
   return it->second;
 }
 
-template<class V>
-bool TbbScanHashtable<V>::Insert(const char *key, V value) {
+template<class V, class MA>
+bool TbbScanHashtable<V, MA>::Insert(const char *key, V value) {
   if (!key) return false;
-  String skey = String::Copy<MemAlloc>(key);
+  String skey = String::Copy<MA>(key);
   tbb::queuing_rw_mutex::scoped_lock lock(mutex_, false);
   return table_.insert(std::make_pair(skey, value)).second;
 }
 
-template<class V>
-V TbbScanHashtable<V>::Update(const char *key, V value) {
+template<class V, class MA>
+V TbbScanHashtable<V, MA>::Update(const char *key, V value) {
   V old(NULL);
   tbb::queuing_rw_mutex::scoped_lock lock(mutex_);
   typename Hashtable::iterator it = table_.find(String::Wrap(key));
@@ -69,21 +69,21 @@ V TbbScanHashtable<V>::Update(const char *key, V value) {
   return old;
 }
 
-template<class V>
-V TbbScanHashtable<V>::Remove(const char *key) {
+template<class V, class MA>
+V TbbScanHashtable<V, MA>::Remove(const char *key) {
   V old(NULL);
   tbb::queuing_rw_mutex::scoped_lock lock(mutex_);
   typename Hashtable::iterator it = table_.find(String::Wrap(key));
   if (it != table_.end()) {
-    String::Free<MemAlloc>(it->first);
+    String::Free<MA>(it->first);
     old = it->second;
     table_.unsafe_erase(it);
   }
   return old;
 }
 
-template<class V>
-std::vector<typename TbbScanHashtable<V>::KVPair> TbbScanHashtable<V>::Entries(
+template<class V, class MA>
+std::vector<typename TbbScanHashtable<V, MA>::KVPair> TbbScanHashtable<V, MA>::Entries(
     const char *key, std::size_t n) const {
   std::vector<KVPair> pairs;
   typename Hashtable::const_iterator pos;
@@ -0,0 +1,174 @@
+//
+// A C++ Redis client that keeps many commands in flight on one connection,
+// using hiredis's asynchronous API driven by a poll() loop
+//
+
+#ifndef YCSB_C_REDIS_ASYNC_CLIENT_H_
+#define YCSB_C_REDIS_ASYNC_CLIENT_H_
+
+#include <iostream>
+#include <vector>
+#include <chrono>
+#include <cstdlib>
+#include <poll.h>
+#include "core/histogram.h"
+#include "redis/hiredis/hiredis.h"
+#include "redis/hiredis/async.h"
+
+namespace ycsbc {
+
+///
+/// Each command's latency, from when it was sent until its reply callback
+/// ran, is added to the histogram it was sent with. Send() only blocks when
+/// max_in_flight commands are waiting for their replies.
+///
+/// Not thread-safe: each thread should have its own.
+///
+class RedisAsyncClient {
+ public:
+  RedisAsyncClient(const char *host, int port, size_t max_in_flight);
+  RedisAsyncClient(const char *unixsocket, size_t max_in_flight); /// Unix-domain socket
+  ~RedisAsyncClient();
+
+  void Send(int argc, const char **argv, const size_t *argvlen,
+            utils::Histogram *latency);
+
+  ///
+  /// Waits for the replies to every command in flight.
+  ///
+  void Drain();
+
+  size_t in_flight() const { return in_flight_; }
+
+ private:
+  struct Request {
+    RedisAsyncClient *client;
+    uint64_t start;
+    utils::Histogram *latency;
+  };
+
+  void Attach();
+  void Poll();
+
+  static void OnReply(redisAsyncContext *context, void *reply, void *privdata);
+
+  // The event loop hooks hiredis calls to say which events it waits for
+  static void AddRead(void *privdata) { ((RedisAsyncClient *)privdata)->events_ |= POLLIN; }
+  static void DelRead(void *privdata) { ((RedisAsyncClient *)privdata)->events_ &= ~POLLIN; }
+  static void AddWrite(void *privdata) { ((RedisAsyncClient *)privdata)->events_ |= POLLOUT; }
+  static void DelWrite(void *privdata) { ((RedisAsyncClient *)privdata)->events_ &= ~POLLOUT; }
+  static void Cleanup(void *privdata) { ((RedisAsyncClient *)privdata)->events_ = 0; }
+
+  static uint64_t NowNanos() {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+  }
+
+  redisAsyncContext *context_;
+  short events_;
+  size_t max_in_flight_;
+  size_t in_flight_;
+  std::vector<Request> requests_;
+  std::vector<Request *> free_requests_;
+};
+
+//
+// Implementation
+//
+inline RedisAsyncClient::RedisAsyncClient(const char *host, int port,
+                                          size_t max_in_flight) :
+    events_(0), max_in_flight_(max_in_flight), in_flight_(0) {
+  context_ = redisAsyncConnect(host, port);
+  Attach();
+}
+
+inline RedisAsyncClient::RedisAsyncClient(const char *unixsocket,
+                                          size_t max_in_flight) :
+    events_(0), max_in_flight_(max_in_flight), in_flight_(0) {
+  context_ = redisAsyncConnectUnix(unixsocket);
+  Attach();
+}
+
+inline void RedisAsyncClient::Attach() {
+  if (!context_ || context_->err) {
+    if (context_) {
+      std::cerr << "Connect error: " << context_->errstr << std::endl;
+      redisAsyncFree(context_);
+    } else {
+      std::cerr << "Connect error: can't allocate redis context!" << std::endl;
+    }
+    exit(1);
+  }
+  context_->ev.addRead = AddRead;
+  context_->ev.delRead = DelRead;
+  context_->ev.addWrite = AddWrite;
+  context_->ev.delWrite = DelWrite;
+  context_->ev.cleanup = Cleanup;
+  context_->ev.data = this;
+
+  // Requests are handed to hiredis as callback data, so they must not move
+  requests_.resize(max_in_flight_);
+  for (Request &request : requests_) {
+    request.client = this;
+    free_requests_.push_back(&request);
+  }
+}
+
+inline RedisAsyncClient::~RedisAsyncClient() {
+  Drain();
+  redisAsyncFree(context_);
+}
+
+inline void RedisAsyncClient::Send(int argc, const char **argv, const size_t *argvlen,
+                                   utils::Histogram *latency) {
+  while (free_requests_.empty()) {
+    Poll();
+  }
+  Request *request = free_requests_.back();
+  free_requests_.pop_back();
+  request->start = NowNanos();
+  request->latency = latency;
+  in_flight_++;
+  if (redisAsyncCommandArgv(context_, OnReply, request, argc, argv, argvlen) != REDIS_OK) {
+    std::cerr << "Command error: " << context_->errstr << std::endl;
+    exit(2);
+  }
+}
+
+inline void RedisAsyncClient::Drain() {
+  while (in_flight_) {
+    Poll();
+  }
+}
+
+inline void RedisAsyncClient::Poll() {
+  struct pollfd pfd = { context_->c.fd, events_, 0 };
+  if (poll(&pfd, 1, -1) < 0) {
+    return; // interrupted; the caller polls again
+  }
+  if (pfd.revents & (POLLIN | POLLERR | POLLHUP)) {
+    redisAsyncHandleRead(context_);
+  }
+  if (pfd.revents & POLLOUT) {
+    redisAsyncHandleWrite(context_);
+  }
+}
+
+inline void RedisAsyncClient::OnReply(redisAsyncContext *context, void *reply,
+                                      void *privdata) {
+  Request *request = (Request *)privdata;
+  RedisAsyncClient *client = request->client;
+  if (!reply) {
+    std::cerr << "Reply error: " << context->errstr << std::endl;
+    exit(2);
+  }
+  if (request->latency) {
+    request->latency->Add(NowNanos() - request->start);
+  }
+  client->in_flight_--;
+  client->free_requests_.push_back(request);
+}
+
+} // namespace ycsbc
+
+#endif // YCSB_C_REDIS_ASYNC_CLIENT_H_
@@ -7,6 +7,12 @@
 
 #include <iostream>
 #include <string>
+#include <cstring>
+#include <vector>
+#include <mutex>
+#include <condition_variable>
+#include <chrono>
+#include "core/histogram.h"
 #include "redis/hiredis/hiredis.h"
 
 namespace ycsbc {
@@ -14,24 +20,122 @@ namespace ycsbc {
 class RedisClient {
  public:
   RedisClient(const char *host, int port, int slaves);
+  RedisClient(const char *unixsocket, int slaves); /// Unix-domain socket
   ~RedisClient();
 
   int Command(std::string cmd);
 
+  ///
+  /// Queues a command. Its reply is only read once pipeline_depth commands
+  /// are queued, or on Flush(), and one WAIT then covers the whole batch.
+  /// If reply_latency is given, the time between the previous reply and this
+  /// command's is added to it: the extra time the command cost by being
+  /// pipelined after the previous one.
+  ///
+  void Append(int argc, const char **argv, const size_t *argvlen,
+              utils::Histogram *reply_latency = NULL);
+
+  ///
+  /// Queues a command without reading any replies, so that the command
+  /// appended next is sent along with it.
+  ///
+  void Queue(int argc, const char **argv, const size_t *argvlen,
+             utils::Histogram *reply_latency = NULL);
+
+  ///
+  /// Waits for the replies to every queued command.
+  ///
+  void Flush();
+
+  void set_pipeline_depth(size_t depth) { pipeline_depth_ = depth; }
+
+  /// Time from queuing each command, and each batch, to its reply
+  const utils::Histogram &command_latency() const { return command_latency_; }
+  const utils::Histogram &batch_latency() const { return batch_latency_; }
+
   redisContext *context() { return context_; }
  private:
+  void CheckConnected();
   void HandleError(redisReply *reply, const char *hint);
 
+  static uint64_t NowNanos() {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+  }
+
   redisContext *context_;
   int slaves_;
+  size_t pipeline_depth_;
+  std::vector<uint64_t> queued_times_; // when each queued command was appended
+  std::vector<utils::Histogram *> reply_latencies_;
+  utils::Histogram command_latency_;
+  utils::Histogram batch_latency_;
+};
+
+///
+/// The argv and argvlen arrays of a command, for hiredis's *Argv functions.
+/// Arguments are passed with their length, so they may hold any bytes, and
+/// reusing one RedisArgv keeps its arrays' capacity from command to command.
+/// The arguments must outlive the command.
+///
+class RedisArgv {
+ public:
+  void Start(const char *command) {
+    argv_.clear();
+    argvlen_.clear();
+    Add(command, strlen(command));
+  }
+  void Add(const char *arg, size_t len) {
+    argv_.push_back(arg);
+    argvlen_.push_back(len);
+  }
+  void Add(const std::string &arg) { Add(arg.data(), arg.size()); }
+
+  int argc() const { return argv_.size(); }
+  const char **argv() { return argv_.data(); }
+  const size_t *argvlen() const { return argvlen_.data(); }
+
+ private:
+  std::vector<const char *> argv_;
+  std::vector<size_t> argvlen_;
+};
+
+///
+/// A fixed set of connections shared by more clients than there are
+/// connections. A client borrows one for each command and waits when they
+/// are all in use.
+///
+class RedisClientPool {
+ public:
+  ~RedisClientPool();
+
+  void Add(RedisClient *client);
+  RedisClient *Acquire();
+  void Release(RedisClient *client);
+
+ private:
+  std::mutex mutex_;
+  std::condition_variable released_;
+  std::vector<RedisClient *> clients_;
+  std::vector<RedisClient *> idle_;
 };
 
 //
 // Implementation
 //
 inline RedisClient::RedisClient(const char *host, int port, int slaves) :
-    slaves_(slaves) {
+    slaves_(slaves), pipeline_depth_(1) {
   context_ = redisConnect(host, port);
+  CheckConnected();
+}
+
+inline RedisClient::RedisClient(const char *unixsocket, int slaves) :
+    slaves_(slaves), pipeline_depth_(1) {
+  context_ = redisConnectUnix(unixsocket);
+  CheckConnected();
+}
+
+inline void RedisClient::CheckConnected() {
   if (!context_ || context_->err) {
     if (context_) {
       std::cerr << "Connect error: " << context_->errstr << std::endl;
@@ -50,6 +154,7 @@ inline RedisClient::~RedisClient() {
 }
 
 inline int RedisClient::Command(std::string cmd) {
+  Flush();
   redisReply *reply;
   redisAppendCommand(context_, cmd.data());
   if (slaves_) {
@@ -68,6 +173,58 @@ inline int RedisClient::Command(std::string cmd) {
   return 0;
 }
 
+inline void RedisClient::Queue(int argc, const char **argv, const size_t *argvlen,
+                               utils::Histogram *reply_latency) {
+  redisAppendCommandArgv(context_, argc, argv, argvlen);
+  queued_times_.push_back(NowNanos());
+  reply_latencies_.push_back(reply_latency);
+}
+
+inline void RedisClient::Append(int argc, const char **argv, const size_t *argvlen,
+                                utils::Histogram *reply_latency) {
+  Queue(argc, argv, argvlen, reply_latency);
+  if (queued_times_.size() >= pipeline_depth_) {
+    Flush();
+  }
+}
+
+inline void RedisClient::Flush() {
+  if (queued_times_.empty()) {
+    return;
+  }
+  redisReply *reply;
+  if (slaves_) {
+    redisAppendCommand(context_, "WAIT %d %d", slaves_, 0);
+  }
+  uint64_t last_reply = NowNanos();
+  for (size_t i = 0; i < queued_times_.size(); i++) {
+    if (redisGetReply(context_, (void **)&reply) == REDIS_ERR) {
+      HandleError(reply, "pipelined command");
+    }
+    freeReplyObject(reply);
+    if (reply_latencies_[i]) {
+      uint64_t now = NowNanos();
+      reply_latencies_[i]->Add(now - last_reply);
+      last_reply = now;
+    } else if (i + 1 < queued_times_.size() && reply_latencies_[i + 1]) {
+      last_reply = NowNanos();
+    }
+  }
+  if (slaves_) {
+    if (redisGetReply(context_, (void **)&reply) == REDIS_ERR) {
+      HandleError(reply, "WAIT");
+    }
+    freeReplyObject(reply);
+  }
+  uint64_t now = NowNanos();
+  for (uint64_t queued : queued_times_) {
+    command_latency_.Add(now - queued);
+  }
+  batch_latency_.Add(now - queued_times_[0]);
+  queued_times_.clear();
+  reply_latencies_.clear();
+}
+
 inline void RedisClient::HandleError(redisReply *reply, const char *hint) {
   std::cerr << hint << " error: " << context_->errstr << std::endl;
   if (reply) freeReplyObject(reply);
@@ -75,6 +232,34 @@ inline void RedisClient::HandleError(redisReply *reply, const char *hint) {
   exit(2); 
 }
 
+inline RedisClientPool::~RedisClientPool() {
+  for (RedisClient *client : clients_) {
+    delete client;
+  }
+}
+
+inline void RedisClientPool::Add(RedisClient *client) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  clients_.push_back(client);
+  idle_.push_back(client);
+}
+
+inline RedisClient *RedisClientPool::Acquire() {
+  std::unique_lock<std::mutex> lock(mutex_);
+  released_.wait(lock, [this] { return !idle_.empty(); });
+  RedisClient *client = idle_.back();
+  idle_.pop_back();
+  return client;
+}
+
+inline void RedisClientPool::Release(RedisClient *client) {
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    idle_.push_back(client);
+  }
+  released_.notify_one();
+}
+
 } // namespace ycsbc
 
 #endif // YCSB_C_REDIS_CLIENT_H_
@@ -15,7 +15,17 @@ int main(int argc, const char *argv[]) {
 
   client.Command("HMSET Ren field1 jinglei@ren.systems field2 Jinglei");
 
-  RedisDB db(host, port, false);
+  utils::Properties props;
+  props.SetProperty("host", host);
+  props.SetProperty("port", to_string(port));
+  props.SetProperty("slaves", "0");
+  props.SetProperty("redis.unixsocket", "");
+  props.SetProperty("redis.pool_size", "0");
+  props.SetProperty("redis.servers", "");
+  props.SetProperty("redis.sharding", "crc16");
+  props.SetProperty("redis.pipeline", "1");
+  props.SetProperty("redis.scan_index", "0");
+  RedisDB db(props);
   db.Init();
   string key = "Ren";
   vector<string> fields;
@@ -41,5 +51,6 @@ int main(int argc, const char *argv[]) {
   result.clear();
   db.Read(key, key, nullptr, result);
   cout << "After delete: " << result.size() << endl;
+  db.Close();
   return 0;
 }
@@ -11,10 +11,15 @@
 #include <iostream>
 #include <vector>
 #include <future>
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <thread>
 #include "core/utils.h"
 #include "core/timer.h"
 #include "core/client.h"
 #include "core/core_workload.h"
+#include "core/measurements.h"
 #include "db/db_factory.h"
 
 using namespace std;
@@ -35,6 +40,13 @@ std::map<string, string> default_props = {
   //
   {"basicdb.verbose", "0"},
 
+  //
+  // In-memory (hashtable) engine config defaults
+  //
+  {"hashtable.layout", "fields"},
+  {"hashtable.allocator", "malloc"},
+  {"hashtable.huge_pages", "0"},
+
   //
   // splinterdb config defaults
   //
@@ -44,6 +56,8 @@ std::map<string, string> default_props = {
 
   {"splinterdb.max_key_size", "24"},
   {"splinterdb.use_log", "1"},
+  {"splinterdb.lookup_buffer_size", "4096"},
+  {"splinterdb.update_mode", "insert"},
 
   // All these options use splinterdb's internal defaults
   {"splinterdb.page_size", "0"},
@@ -62,7 +76,41 @@ std::map<string, string> default_props = {
   {"splinterdb.use_stats", "0"},
   {"splinterdb.reclaim_threshold", "0"},
 
+  //
+  // redis config defaults
+  //
+  {"host", "127.0.0.1"},
+  {"port", "6379"},
+  {"slaves", "0"},
+  {"redis.unixsocket", ""},
+  {"redis.pool_size", "0"},
+  {"redis.servers", ""},
+  {"redis.sharding", "crc16"},
+  {"redis.pipeline", "1"},
+  {"redis.scan_index", "0"},
+  {"redis.async_depth", "16"},
+
+  //
+  // memcached config defaults
+  //
+  {"memcached.host", "127.0.0.1"},
+  {"memcached.port", "11211"},
+  {"memcached.unixsocket", ""},
+  {"memcached.protocol", "text"},
+  {"memcached.batch_size", "1"},
+
   {"rocksdb.database_filename", "rocksdb.db"},
+  {"rocksdb.bulk_load.file_size_mb", "256"},
+  {"rocksdb.batch_size", "1"},
+  {"rocksdb.batch_us", "0"},
+  {"rocksdb.scan_refresh_interval", "1"},
+  {"rocksdb.scan_upper_bound_stride", "0"},
+  {"rocksdb.column_family_per_table", "0"},
+  {"rocksdb.statistics", "none"},
+  {"rocksdb.perf_sample_rate", "0"},
+  {"rocksdb.merge_operator", "none"},
+  {"rocksdb.transactions", "none"},
+  {"rocksdb.transaction_lock_timeout_ms", "1000"},
 };
 
 
@@ -126,7 +174,8 @@ int DelegateClient(ycsbc::DB *db,
                    progress_mode pmode,
                    uint64_t total_ops,
                    volatile uint64_t *global_op_counter,
-                   volatile uint64_t *last_printed) {
+                   volatile uint64_t *last_printed,
+                   ycsbc::Measurements *measurements) {
   db->Init();
   ycsbc::Client client(*db, *wl);
   uint64_t oks = 0;
@@ -142,7 +191,70 @@ int DelegateClient(ycsbc::DB *db,
       ProgressUpdate(pmode, total_ops, global_op_counter, i, last_printed);
     }
   }
+  client.Finish();
   ProgressFinish(pmode, total_ops, global_op_counter, num_ops, last_printed);
+  *measurements = client.measurements();
+  db->Close();
+  return oks;
+}
+
+//
+// Loads this thread's share of the records, in key order, through the
+// DB's bulk load path.
+//
+int BulkLoadClient(ycsbc::DB *db,
+                   ycsbc::CoreWorkload *wl,
+                   unsigned int num_threads,
+                   unsigned int this_thread,
+                   progress_mode pmode,
+                   uint64_t total_ops,
+                   volatile uint64_t *global_op_counter,
+                   volatile uint64_t *last_printed,
+                   ycsbc::Measurements *measurements) {
+  db->Init();
+  ycsbc::Client client(*db, *wl);
+  uint64_t oks = 0;
+  uint64_t num_ops = wl->InitBulkLoadKeys(num_threads, this_thread);
+
+  for (uint64_t i = 0; i < num_ops; ++i) {
+    oks += client.DoBulkInsert();
+    ProgressUpdate(pmode, total_ops, global_op_counter, i, last_printed);
+  }
+  ProgressFinish(pmode, total_ops, global_op_counter, num_ops, last_printed);
+  *measurements = client.measurements();
+  db->Close();
+  return oks;
+}
+
+//
+// Keeps inserting new records, at up to rate records per second (0 for
+// unthrottled), until max_ops records are inserted (0 for no limit) or
+// done is set by the main thread.
+//
+int LoaderClient(ycsbc::DB *db,
+                 ycsbc::CoreWorkload *wl,
+                 double rate,
+                 uint64_t max_ops,
+                 atomic<bool> *done,
+                 double *duration,
+                 ycsbc::Measurements *measurements) {
+  db->Init();
+  ycsbc::Client client(*db, *wl);
+  uint64_t oks = 0;
+  utils::Timer<double> timer;
+  chrono::steady_clock::time_point start = chrono::steady_clock::now();
+
+  timer.Start();
+  for (uint64_t i = 0; (max_ops == 0 || i < max_ops) && !done->load(); ++i) {
+    if (rate > 0) {
+      chrono::duration<double> offset(i / rate);
+      this_thread::sleep_until(start + chrono::duration_cast<chrono::steady_clock::duration>(offset));
+    }
+    oks += client.DoInsert();
+  }
+  client.Finish();
+  *duration = timer.End();
+  *measurements = client.measurements();
   db->Close();
   return oks;
 }
@@ -166,6 +278,11 @@ int main(const int argc, const char *argv[]) {
   uint64_t sum;
   utils::Timer<double> timer;
 
+  // DBs that pack the fields of a record need to tell updates of the whole
+  // record from updates of some of its fields
+  props.SetProperty(ycsbc::CoreWorkload::FIELD_COUNT_PROPERTY,
+                    load_workload.props.GetProperty(ycsbc::CoreWorkload::FIELD_COUNT_PROPERTY,
+                                                    ycsbc::CoreWorkload::FIELD_COUNT_DEFAULT));
   ycsbc::DB *db = ycsbc::DBFactory::CreateDB(props, load_workload.preloaded);
   if (!db) {
     cout << "Unknown database name " << props["dbname"] << endl;
@@ -179,12 +296,19 @@ int main(const int argc, const char *argv[]) {
   if (batch_size < 1)
     batch_size = 1;
 
-  ycsbc::BatchedCounterGenerator key_generator(load_workload.preloaded ? record_count : 0, batch_size);
+  // A bulk load does not take its keys from the generator
+  const bool bulk_load = load_workload.props.GetProperty(
+      ycsbc::CoreWorkload::LOAD_MODE_PROPERTY,
+      ycsbc::CoreWorkload::LOAD_MODE_DEFAULT) == "bulk";
+  ycsbc::BatchedCounterGenerator key_generator(load_workload.preloaded || bulk_load ? record_count : 0, batch_size);
   ycsbc::CoreWorkload wls[num_threads];
   for (unsigned int i = 0; i < num_threads; ++i) {
     wls[i].InitLoadWorkload(load_workload.props, num_threads, i, &key_generator);
   }
 
+  ycsbc::Measurements measurements[num_threads];
+  ycsbc::Measurements total_measurements;
+
   // Perform the Load phase
   if (!load_workload.preloaded) {
     timer.Start();
@@ -195,9 +319,17 @@ int main(const int argc, const char *argv[]) {
       for (unsigned int i = 0; i < num_threads; ++i) {
         uint64_t start_op = (record_count * i) / num_threads;
         uint64_t end_op = (record_count * (i + 1)) / num_threads;
-        actual_ops.emplace_back(async(launch::async, DelegateClient, db,
-                                      &wls[i], end_op - start_op, true,
-                                      pmode, record_count, &load_progress, &last_printed));
+        if (bulk_load) {
+          actual_ops.emplace_back(async(launch::async, BulkLoadClient, db,
+                                        &wls[i], num_threads, i,
+                                        pmode, record_count, &load_progress, &last_printed,
+                                        &measurements[i]));
+        } else {
+          actual_ops.emplace_back(async(launch::async, DelegateClient, db,
+                                        &wls[i], end_op - start_op, true,
+                                        pmode, record_count, &load_progress, &last_printed,
+                                        &measurements[i]));
+        }
       }
       assert(actual_ops.size() == num_threads);
       sum = 0;
@@ -209,10 +341,25 @@ int main(const int argc, const char *argv[]) {
         cout << "\n";
       }
     }
+    double generate_duration = timer.End();
+    if (bulk_load) {
+      db->FinishBulkLoad();
+    }
     double load_duration = timer.End();
+    if (bulk_load) {
+      cerr << "# Bulk load generation time (s):\t" << generate_duration << endl;
+      cerr << "# Bulk load ingest time (s):\t" << load_duration - generate_duration << endl;
+    }
     cerr << "# Load throughput (KTPS)" << endl;
     cerr << props["dbname"] << '\t' << load_workload.filename << '\t' << num_threads << '\t';
     cerr << sum / load_duration / 1000 << endl;
+
+    total_measurements.Clear();
+    for (unsigned int i = 0; i < num_threads; ++i) {
+      total_measurements.Merge(measurements[i]);
+    }
+    total_measurements.Print(cerr, "Load");
+    db->PrintStats();
   }
 
 
@@ -224,8 +371,45 @@ int main(const int argc, const char *argv[]) {
     }
     actual_ops.clear();
     total_ops = stoi(workload.props[ycsbc::CoreWorkload::OPERATION_COUNT_PROPERTY]);
+
+    // Optionally keep loading new records while the Run workload executes
+    unsigned int num_loaders = stoi(workload.props.GetProperty(
+        ycsbc::CoreWorkload::LOAD_THREADS_PROPERTY,
+        ycsbc::CoreWorkload::LOAD_THREADS_DEFAULT));
+    const double load_rate = stod(workload.props.GetProperty(
+        ycsbc::CoreWorkload::LOAD_RATE_PROPERTY,
+        ycsbc::CoreWorkload::LOAD_RATE_DEFAULT));
+    const uint64_t load_count = stoull(workload.props.GetProperty(
+        ycsbc::CoreWorkload::LOAD_COUNT_PROPERTY,
+        ycsbc::CoreWorkload::LOAD_COUNT_DEFAULT));
+    if (load_count > 0 && num_loaders > load_count) {
+      // A loader given no records would insert without limit
+      num_loaders = load_count;
+    }
+    const chrono::duration<double> report_interval(stod(workload.props.GetProperty(
+        ycsbc::CoreWorkload::LOAD_REPORT_INTERVAL_PROPERTY,
+        ycsbc::CoreWorkload::LOAD_REPORT_INTERVAL_DEFAULT)));
+    unique_ptr<ycsbc::CoreWorkload[]> loader_wls(new ycsbc::CoreWorkload[num_loaders]);
+    unique_ptr<ycsbc::Measurements[]> loader_measurements(new ycsbc::Measurements[num_loaders]);
+    vector<double> loader_durations(num_loaders);
+    vector<future<int>> loader_ops;
+    vector<pair<double, uint64_t>> size_samples;
+    atomic<bool> loading_done(false);
+
     timer.Start();
     {
+      for (unsigned int i = 0; i < num_loaders; ++i) {
+        uint64_t start_op = (load_count * i) / num_loaders;
+        uint64_t end_op = (load_count * (i + 1)) / num_loaders;
+        loader_wls[i].InitLoadWorkload(load_workload.props, num_loaders,
+                                       num_threads + i, &key_generator);
+        loader_ops.emplace_back(async(launch::async, LoaderClient, db,
+                                      &loader_wls[i], load_rate / num_loaders,
+                                      end_op - start_op,
+                                      &loading_done, &loader_durations[i],
+                                      &loader_measurements[i]));
+      }
+
       cerr << "# Transaction count:\t" << total_ops << endl;
       uint64_t run_progress = 0;
       uint64_t last_printed = 0;
@@ -234,9 +418,20 @@ int main(const int argc, const char *argv[]) {
         uint64_t end_op = (total_ops * (i + 1)) / num_threads;
         actual_ops.emplace_back(async(launch::async, DelegateClient, db,
                                       &wls[i], end_op - start_op, false,
-                                      pmode, total_ops, &run_progress, &last_printed));
+                                      pmode, total_ops, &run_progress, &last_printed,
+                                      &measurements[i]));
       }
       assert(actual_ops.size() == num_threads);
+      if (num_loaders > 0) {
+        utils::Timer<double> sample_timer;
+        sample_timer.Start();
+        for (auto &n : actual_ops) {
+          while (n.wait_for(report_interval) != future_status::ready) {
+            size_samples.emplace_back(sample_timer.End(), key_generator.Last());
+          }
+        }
+        size_samples.emplace_back(sample_timer.End(), key_generator.Last());
+      }
       sum = 0;
       for (auto &n : actual_ops) {
         assert(n.valid());
@@ -248,9 +443,42 @@ int main(const int argc, const char *argv[]) {
     }
     double run_duration = timer.End();
 
+    loading_done = true;
+    uint64_t load_sum = 0;
+    double load_duration = 0;
+    for (unsigned int i = 0; i < num_loaders; ++i) {
+      load_sum += loader_ops[i].get();
+      load_duration = max(load_duration, loader_durations[i]);
+    }
+
     cerr << "# Transaction throughput (KTPS)" << endl;
     cerr << props["dbname"] << '\t' << workload.filename << '\t' << num_threads << '\t';
     cerr << sum / run_duration / 1000 << endl;
+
+    total_measurements.Clear();
+    for (unsigned int i = 0; i < num_threads; ++i) {
+      total_measurements.Merge(measurements[i]);
+    }
+    total_measurements.Print(cerr, "Transaction");
+
+    if (num_loaders > 0) {
+      cerr << "# Concurrent load throughput (KTPS)" << endl;
+      cerr << props["dbname"] << '\t' << load_workload.filename << '\t' << num_loaders << '\t';
+      cerr << load_sum / load_duration / 1000 << endl;
+
+      total_measurements.Clear();
+      for (unsigned int i = 0; i < num_loaders; ++i) {
+        total_measurements.Merge(loader_measurements[i]);
+      }
+      total_measurements.Print(cerr, "Concurrent load");
+
+      cerr << "# Records in database over time" << endl;
+      cerr << "#\tseconds\trecords" << endl;
+      for (auto &sample : size_samples) {
+        cerr << "#\t" << sample.first << '\t' << sample.second << endl;
+      }
+    }
+    db->PrintStats();
   }
 
   delete db;